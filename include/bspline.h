@@ -27,8 +27,11 @@ public:
      * Implemented in BSplineBuilder.*
      */
     class Builder;
+    class FitPlan;
+    class OnlineFit;
     enum class Smoothing;
     enum class KnotSpacing;
+    enum class Solver;
 
     BSpline(unsigned int numVariables);
 
@@ -61,6 +64,31 @@ public:
     DenseMatrix evalJacobian(DenseVector x) const override;
     DenseMatrix evalHessian(DenseVector x) const override;
 
+    /*
+     * Value and derivatives at a point, as returned by evalAll.
+     * jacobian is 1 x numVariables and hessian is numVariables x numVariables (empty if not requested).
+     */
+    struct Evaluation
+    {
+        double value;
+        DenseMatrix jacobian;
+        DenseMatrix hessian;
+    };
+
+    /*
+     * Evaluates the value, the Jacobian (if order >= 1) and the Hessian (if order = 2) at x
+     * from a single evaluation of the basis functions and their derivatives in each variable.
+     */
+    Evaluation evalAll(DenseVector x, unsigned int order = 2) const;
+
+    /*
+     * Batch evaluation of the N points stored as the rows of X (an N x numVariables matrix).
+     * out receives the N function values, or the N x numVariables Jacobians, respectively.
+     * Points outside the domain evaluate to zero.
+     */
+    void evalBatch(const DenseMatrix &X, Eigen::Ref<DenseVector> out) const;
+    void evalJacobianBatch(const DenseMatrix &X, Eigen::Ref<DenseMatrix> out) const;
+
     // Evaluation of B-spline basis functions
     SparseVector evalBasis(DenseVector x) const;
     SparseMatrix evalBasisJacobian(DenseVector x) const;
@@ -68,7 +96,7 @@ public:
     /**
      * Getters
      */
-    DenseVector getCoefficients()
+    DenseVector getCoefficients() const
     {
         return coefficients;
     }
@@ -100,11 +128,15 @@ public:
      * Setters
      */
     void setCoefficients(const DenseVector &coefficients);
+    /*
+     * Sets the coefficients from the last column of the control points. The x-coordinates (the other columns)
+     * are not stored: they must equal the knot averages of the basis (see getControlPoints), or an exception is thrown.
+     */
     void setControlPoints(const DenseMatrix &controlPoints);
     void checkControlPoints() const;
 
     // Linear transformation of control points (B-spline has affine invariance)
-    void updateControlPoints(const DenseMatrix &A);
+    void updateControlPoints(const KroneckerOperator &A);
 
     // Reduce support of B-spline
     void reduceSupport(std::vector<double> lb, std::vector<double> ub, bool doRegularizeKnotVectors = true);
@@ -133,12 +165,15 @@ protected:
     /*
      * The control point matrix is P = (knotaverages, coefficients) in R^(m x n),
      * where m = numBasisFunctions and n = numVariables + 1. Each row in P is a control point.
+     * The knot averages of the tensor product basis are the Kronecker expansion of the knot averages of each variable,
+     * so only the numVariables 1-D vectors are stored, and P is formed by getControlPoints.
      */
     DenseVector coefficients;
-    DenseMatrix knotaverages;
+    std::vector<DenseVector> knotaverages;
 
     // Control point computations
-    DenseMatrix computeKnotAverages() const;
+    std::vector<DenseVector> computeKnotAverages() const;
+    DenseMatrix expandKnotAverages() const;
 
 private:
     // Domain reduction
@@ -148,6 +183,13 @@ private:
     // Helper functions
     bool pointInDomain(DenseVector x) const;
 
+    /*
+     * Copies count rows of X, starting at row start, to the column-major buffer xs for batch evaluation.
+     * Points outside the domain [lb, ub] are replaced by the lower bound lb and flagged in inside.
+     */
+    void loadBatchPoints(const DenseMatrix &X, int start, int count, const double *lb, const double *ub,
+                         double *xs, char *inside) const;
+
     void load(const std::string &fileName) override;
 
     friend class Serializer;
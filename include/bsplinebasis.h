@@ -12,10 +12,14 @@
 
 #include "definitions.h"
 #include "bsplinebasis1d.h"
+#include "mykroneckerproduct.h"
 
 namespace SPLINTER
 {
 
+// Highest number of variables supported by the tensor-product contraction (the coefficient tensor would not fit in memory)
+const unsigned int MAX_CONTRACTION_VARIABLES = 32;
+
 class BSplineBasis
 {
 public:
@@ -29,14 +33,76 @@ public:
     SparseMatrix evalBasisJacobian2(DenseVector &x) const; // A bit slower than evaBasisJacobianOld()
     SparseMatrix evalBasisHessian(DenseVector &x) const;
 
-    // Knot vector manipulation
-    SparseMatrix refineKnots();
-    SparseMatrix refineKnotsLocally(DenseVector x);
-    SparseMatrix decomposeToBezierForm();
-    SparseMatrix insertKnots(double tau, unsigned int dim, unsigned int multiplicity = 1);
+    /*
+     * Allocation-free evaluation of the basis functions supported at x, which must hold numVariables values.
+     * The values (or rth derivatives) are written variable by variable in blocks of degree+1 elements,
+     * and first receives the index of the first supported basis function in each variable.
+     * Returns false, without writing anything, if x is outside the support.
+     * If spans is given, it holds the knot interval hint of each variable and is updated with the intervals of x.
+     */
+    bool evalSupported(const double *x, double *values, unsigned int *first, int *spans = nullptr) const;
+    bool evalSupportedDerivative(const double *x, unsigned int r, double *values, unsigned int *first, int *spans = nullptr) const;
+
+    /*
+     * Evaluates the derivatives of order 0 to maxOrder in one pass. The values of variable dim are written in a block of
+     * (maxOrder+1)*(degree+1) elements (the blocks follow each other), where order r starts at element r*(degree+1).
+     */
+    bool evalSupportedDerivatives(const double *x, unsigned int maxOrder, double *values, unsigned int *first) const;
+
+    /*
+     * Batched version of evalSupportedDerivative for the n points in the column-major n x numVariables matrix X,
+     * which must all be inside the support. The values and first indices of point i are written to
+     * values + i*getNumSupportedValues() and first + i*numVariables, in the layout of evalSupported.
+     */
+    void evalSupportedBatch(const double *X, size_t n, double *values, unsigned int *first, unsigned int r = 0) const;
+
+    /*
+     * Evaluates the supportedPrInterval() tensor-product basis functions that are nonzero at x, writing their values
+     * and indices (in increasing order) to values and indices. Returns false, without writing anything, if x is outside the support.
+     */
+    bool evalSupportedTensorProduct(const double *x, double *values, int *indices) const;
+
+    /*
+     * Contracts the coefficients with the tensor product of the per-variable weights,
+     * i.e. computes sum_k c_k*w_0(k_0)*...*w_(n-1)(k_(n-1)) over the supported basis functions.
+     * weights holds one pointer per variable to degree+1 weights.
+     * The contraction is sum-factorized: one variable is summed out at a time, starting with the last
+     * (contiguous) variable, so the tensor-product basis vector is never formed.
+     */
+    double contract(const DenseVector &coefficients, const double * const *weights, const unsigned int *first) const;
+
+    /*
+     * Contracts the coefficients with the weights and, in the same sweep, with the weights where variable j
+     * is replaced by its derivative weights, for all j. Returns the value and writes the numVariables partials to gradient.
+     */
+    double contractGradient(const DenseVector &coefficients, const double * const *weights,
+                            const double * const *derivativeWeights, const unsigned int *first, double *gradient) const;
+
+    // Evaluates sum_k c_k*B_k(x) by contraction, without allocation for degrees up to MAX_KERNEL_DEGREE. Returns 0 outside the support.
+    double evalContracted(const DenseVector &coefficients, const double *x) const;
+
+    // As evalContracted, also writing the gradient (zero outside the support)
+    double evalGradientContracted(const DenseVector &coefficients, const double *x, double *gradient) const;
+
+    // Writes the numVariables x numVariables Hessian (column-major) of sum_k c_k*B_k(x) to hessian (zero outside the support)
+    void evalHessianContracted(const DenseVector &coefficients, const double *x, double *hessian) const;
+
+    /*
+     * Evaluates sum_k c_k*B_k(x) and its derivatives up to the given order (at most 2) from one evaluation of the
+     * basis derivatives of order 0 to order. Writes the gradient if order >= 1 and the Hessian (column-major) if order = 2;
+     * the other output pointers are not used and may be null. Returns the value (all outputs are zero outside the support).
+     */
+    double evalAllContracted(const DenseVector &coefficients, const double *x, unsigned int order,
+                             double *gradient, double *hessian) const;
+
+    // Knot vector manipulation (returns the knot insertion matrix as a lazy Kronecker product of the 1-D matrices)
+    KroneckerOperator refineKnots();
+    KroneckerOperator refineKnotsLocally(DenseVector x);
+    KroneckerOperator decomposeToBezierForm();
+    KroneckerOperator insertKnots(double tau, unsigned int dim, unsigned int multiplicity = 1);
 
     // Getters
-    BSplineBasis1D getSingleBasis(int dim);
+    BSplineBasis1D getSingleBasis(int dim) const;
     std::vector< std::vector<double> > getKnotVectors() const;
     std::vector<double> getKnotVector(int dim) const;
 
@@ -51,15 +117,26 @@ public:
     unsigned int getLargestKnotInterval(unsigned int dim) const;
 
     int supportedPrInterval() const;
+    unsigned int getNumSupportedValues() const; // Sum of degree+1 over all variables
 
     bool insideSupport(DenseVector &x) const;
     std::vector<double> getSupportLowerBound() const;
     std::vector<double> getSupportUpperBound() const;
 
     // Support related
-    SparseMatrix reduceSupport(std::vector<double>& lb, std::vector<double>& ub);
+    KroneckerOperator reduceSupport(std::vector<double>& lb, std::vector<double>& ub);
 
 private:
+    double contract(const double *coefficients, const double * const *weights, const unsigned int *first) const;
+    double contractGradient(const double *coefficients, const double * const *weights,
+                            const double * const *derivativeWeights, const unsigned int *first, double *gradient) const;
+
+    /*
+     * Computes the Hessian from the derivatives of order 0, 1 and 2 in the layout of evalSupportedDerivatives,
+     * one contraction per element of the lower triangle.
+     */
+    void contractHessian(const double *coefficients, const double *values, const unsigned int *first, double *hessian) const;
+
     std::vector<BSplineBasis1D> bases;
     unsigned int numVariables;
 
@@ -11,6 +11,8 @@
 #define SPLINTER_BSPLINEBASIS1D_H
 
 #include "definitions.h"
+#include "bsplinebasiskernel.h"
+#include "knotintervallocator.h"
 
 namespace SPLINTER
 {
@@ -26,6 +28,29 @@ public:
     SparseVector evalDerivative(double x, int r) const;
     SparseVector evalFirstDerivative(double x) const; // Depricated
 
+    /*
+     * Allocation-free evaluation of the degree+1 basis functions supported at x.
+     * The values are written to the caller-provided array and the index of the first supported
+     * basis function is returned. Throws if x is outside the support.
+     * If span is given, a nonnegative value is used as a hint for the knot interval (typically the interval of
+     * the previous query), and span receives the knot interval of x.
+     */
+    unsigned int evalSupported(double x, double *values, int *span = nullptr) const;
+    unsigned int evalSupportedDerivative(double x, unsigned int r, double *values, int *span = nullptr) const;
+
+    // Evaluates the derivatives of order 0 to maxOrder with one knot interval search, order r is written to values + r*(degree+1)
+    unsigned int evalSupportedDerivatives(double x, unsigned int maxOrder, double *values, int *span = nullptr) const;
+
+    /*
+     * Evaluates the rth derivative of the supported basis functions at the n points x, several points at a time
+     * with the widest SIMD kernel supported by the CPU. The degree+1 values of point i are written to
+     * values + i*valueStride and the index of its first supported basis function to first[i*firstStride].
+     * Throws if a point is outside the support.
+     */
+    void evalBatch(const double *x, size_t n, double *values, unsigned int *first, unsigned int r = 0) const;
+    void evalBatch(const double *x, size_t n, double *values, size_t valueStride,
+                   unsigned int *first, size_t firstStride, unsigned int r = 0) const;
+
     // Knot vector related
     SparseMatrix refineKnots();
     SparseMatrix refineKnotsLocally(double x);
@@ -49,6 +74,7 @@ public:
     // Index getters
     std::vector<int> indexSupportedBasisfunctions(double x) const;
     int indexHalfopenInterval(double x) const;
+    int indexHalfopenInterval(double x, int hint) const;
     unsigned int indexLongestInterval() const;
     unsigned int indexLongestInterval(const std::vector<double> &vec) const;
 
@@ -63,8 +89,25 @@ private:
     double deBoorCox(double x, int i, int k) const;
     double deBoorCoxCoeff(double x, double x_min, double x_max) const;
 
-    // Builds basis matrix for alternative evaluation of basis functions
-    SparseMatrix buildBasisMatrix(double x, unsigned int u, unsigned int k, bool diff = false) const;
+    /*
+     * Triangular evaluation of the rth derivative of the degree+1 basis functions
+     * [B_(u-p,p)(x) ... B_(u,p)(x)] in knot interval u, in O(p^2) operations and without allocation.
+     * Implements Algorithm 3.18 from Lyche and Moerken (2011) by applying the basis matrices in place.
+     * Dispatches to the degree-specialized kernel when there is one.
+     */
+    void deBoorKernel(double x, int u, unsigned int r, double *values) const;
+
+    // Index of the first of the degree+1 basis functions supported in the knot interval u
+    unsigned int indexFirstSupported(int u) const;
+
+    // Storage for degree+1 basis function values
+    double *valueBuffer(double *buffer, std::vector<double> &heapBuffer) const;
+
+    // Replaces the knot vector and rebuilds the knot interval locator
+    void setKnots(const std::vector<double> &newKnots);
+
+    // Moves the values computed by deBoorKernel to the window starting at indexFirstSupported(u)
+    unsigned int shiftToSupported(int u, double *values) const;
 
     /*
      * Builds knot insertion matrix
@@ -80,6 +123,12 @@ private:
     std::vector<double> knots;
     unsigned int targetNumBasisfunctions;
 
+    // Knot interval lookup, rebuilt whenever the knots change
+    KnotIntervalLocator locator;
+
+    // Degree-specialized basis kernel (nullptr if there is none), chosen from the degree
+    BasisKernelFunction kernel;
+
     friend class Serializer;
     friend bool operator==(const BSplineBasis1D &lhs, const BSplineBasis1D &rhs);
     friend bool operator!=(const BSplineBasis1D &lhs, const BSplineBasis1D &rhs);
@@ -0,0 +1,36 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#ifndef SPLINTER_BSPLINEBASISBATCH_H
+#define SPLINTER_BSPLINEBASISBATCH_H
+
+namespace SPLINTER
+{
+
+/*
+ * Signature of the multi-point basis kernels, which evaluate the rth derivative of the degree+1 supported
+ * basis functions for a block of points (one point per SIMD lane) in structure-of-arrays layout:
+ * - x[lane] is the point,
+ * - T[m*lanes + lane] is the knot with index u - degree + 1 + m (m < 2*degree) in the knot interval u of the point,
+ * - N[k*lanes + lane] receives the value of basis function u - degree + k, before scaling by degree!/(degree-r)!.
+ */
+typedef void (*BasisBlockFunction)(const double *T, const double *x, unsigned int degree, unsigned int r, double *N);
+
+struct BasisBlockKernel
+{
+    unsigned int lanes; // Points per block, 1 if there is no vectorized kernel
+    BasisBlockFunction function;
+};
+
+// Returns the widest kernel supported by the CPU (AVX-512, AVX2 or none), detected once at runtime
+BasisBlockKernel getBasisBlockKernel();
+
+} // namespace SPLINTER
+
+#endif // SPLINTER_BSPLINEBASISBATCH_H
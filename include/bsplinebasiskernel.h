@@ -0,0 +1,144 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#ifndef SPLINTER_BSPLINEBASISKERNEL_H
+#define SPLINTER_BSPLINEBASISKERNEL_H
+
+#include <algorithm>
+#include <array>
+
+namespace SPLINTER
+{
+
+// Highest degree with a compile-time specialized kernel (equal to the highest degree used by the builder)
+const unsigned int MAX_KERNEL_DEGREE = 5;
+
+/*
+ * Signature of the basis kernels: evaluates the rth derivative of the degree+1 basis functions
+ * [B_(u-p,p)(x) ... B_(u,p)(x)] in knot interval u, where knots is the knot vector of length numKnots.
+ */
+typedef void (*BasisKernelFunction)(const double *knots, int numKnots, double x, int u, unsigned int r, double *values);
+
+// Knot value with the index clamped to the knot vector
+inline double knotClamped(const double *knots, int numKnots, int i)
+{
+    return knots[std::max(0, std::min(i, numKnots - 1))];
+}
+
+/*
+ * Computes values*R_k, where R_k in R^(k,k+1) is the B-spline matrix (or DR_k, the differentiated
+ * basis matrix, if diff = true). The product is computed in place, starting from the last row of R_k,
+ * so that values must have room for k+1 elements.
+ */
+inline void applyBasisMatrix(const double *knots, int numKnots, double x, int u, unsigned int k, bool diff, double *values)
+{
+    values[k] = 0;
+
+    for (int i = k - 1; i >= 0; --i)
+    {
+        double v = values[i];
+        values[i] = 0;
+
+        double tl = knotClamped(knots, numKnots, u + 1 + i - k);
+        double tr = knotClamped(knots, numKnots, u + 1 + i);
+        double dk = tr - tl;
+
+        if (dk == 0)
+            continue;
+
+        if (diff)
+        {
+            // Diagonal and super-diagonal element
+            values[i] = -v/dk;
+            values[i+1] += v/dk;
+        }
+        else
+        {
+            // Convex combination, as in the recursive deBoorCox
+            double alpha = (x - tl)/dk;
+            values[i] = v*(1 - alpha);
+            values[i+1] += v*alpha;
+        }
+    }
+}
+
+/*
+ * Basis kernel for a fixed degree P. The basis matrices R_1 ... R_P are applied by a recursion over
+ * the level K that is resolved at compile time, so that all loops have fixed trip counts and are unrolled.
+ * Requires r <= P.
+ */
+template <unsigned int P>
+class BasisKernel
+{
+public:
+    static std::array<double, P+1> eval(const double *knots, int numKnots, double x, int u, unsigned int r = 0)
+    {
+        std::array<double, P+1> values;
+        evalInto(knots, numKnots, x, u, r, values.data());
+        return values;
+    }
+
+    static void evalInto(const double *knots, int numKnots, double x, int u, unsigned int r, double *values)
+    {
+        values[0] = 1;
+        Level<1>::apply(knots, numKnots, x, u, r, values);
+
+        // Scale derivatives by P!/(P-r)!
+        if (r > 0)
+        {
+            double factorial = 1;
+            for (unsigned int k = P - r + 1; k <= P; ++k)
+                factorial *= k;
+
+            for (unsigned int k = 0; k <= P; ++k)
+                values[k] *= factorial;
+        }
+    }
+
+private:
+    template <unsigned int K, bool Done = (K > P)>
+    struct Level
+    {
+        static void apply(const double *knots, int numKnots, double x, int u, unsigned int r, double *values)
+        {
+            applyBasisMatrix(knots, numKnots, x, u, K, K + r > P, values);
+            Level<K+1>::apply(knots, numKnots, x, u, r, values);
+        }
+    };
+
+    template <unsigned int K>
+    struct Level<K, true>
+    {
+        static void apply(const double *, int, double, int, unsigned int, double *)
+        {
+        }
+    };
+};
+
+// Returns the specialized kernel for the given degree, or nullptr if degree > MAX_KERNEL_DEGREE
+inline BasisKernelFunction getBasisKernel(unsigned int degree)
+{
+    static const BasisKernelFunction kernels[MAX_KERNEL_DEGREE + 1] = {
+        &BasisKernel<0>::evalInto,
+        &BasisKernel<1>::evalInto,
+        &BasisKernel<2>::evalInto,
+        &BasisKernel<3>::evalInto,
+        &BasisKernel<4>::evalInto,
+        &BasisKernel<5>::evalInto
+    };
+
+    if (degree > MAX_KERNEL_DEGREE)
+        return nullptr;
+
+    return kernels[degree];
+}
+
+} // namespace SPLINTER
+
+#endif // SPLINTER_BSPLINEBASISKERNEL_H
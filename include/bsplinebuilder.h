@@ -12,6 +12,7 @@
 
 #include "datatable.h"
 #include "bspline.h"
+#include "iterativesolvers.h"
 
 namespace SPLINTER
 {
@@ -37,6 +38,117 @@ enum class BSpline::KnotSpacing
     EXPERIMENTAL    // Experimental knot spacing (for testing purposes).
 };
 
+// Linear solver for the B-spline coefficients
+enum class BSpline::Solver
+{
+    DEFAULT,    // Dense QR for small systems; otherwise sparse LU for square and sparse QR for rectangular systems (dense QR if the sparse factorization fails)
+    KRONECKER,  // Per-variable solves using B = B_0 x ... x B_(d-1) on complete grids, without forming B or the normal equations
+    LSQR,       // Iterative least squares (LSQR) using only products with B
+    CGLS,       // Conjugate gradients on the least squares problem (CGLS) using only products with B
+    CG          // Conjugate gradients on the normal equations, without forming them
+};
+
+/*
+ * Fit plan for repeated fits on the same sample points, created by BSpline::Builder::plan.
+ * The knot vectors, basis matrix and factorization (or preconditioner) of the builder are computed once,
+ * so that a fit only solves with the stored factors. The sample values are given in the order of the samples
+ * of the data table of the builder (sorted by x), with one column per fit.
+ */
+class SPLINTER_API BSpline::FitPlan
+{
+public:
+    // Maps the sample values (one column per fit) to the coefficients (one column per fit)
+    typedef std::function<DenseMatrix(const DenseMatrix &, SolverStatistics &)> CoefficientSolver;
+
+    // Fit B-spline to the sample values y (throws if an iterative solver does not converge)
+    BSpline fit(const DenseVector &y) const;
+
+    // Fit B-spline to the sample values y and report the convergence of the solver
+    BSpline fit(const DenseVector &y, SolverStatistics &statistics) const;
+
+    // Fit one B-spline per column of Y
+    std::vector<BSpline> fit(const DenseMatrix &Y) const;
+
+    // Fit one B-spline per column of Y, statistics holds the worst convergence over the columns
+    std::vector<BSpline> fit(const DenseMatrix &Y, SolverStatistics &statistics) const;
+
+    // Coefficients of the B-splines fitted to the columns of Y (one column per B-spline)
+    DenseMatrix fitCoefficients(const DenseMatrix &Y, SolverStatistics &statistics) const;
+
+    unsigned int getNumSamples() const { return _numSamples; }
+
+private:
+    FitPlan(const BSpline &bspline, unsigned int numSamples, CoefficientSolver solver);
+
+    BSpline _bspline; // B-spline with default coefficients
+    unsigned int _numSamples;
+    CoefficientSolver _solver;
+
+    friend class BSpline::Builder;
+};
+
+/*
+ * Online least squares fit with the fixed knots of a builder, created by BSpline::Builder::online.
+ * The normal equations A = B'*B + alpha*R and B'*y are kept up to date as samples are added: a sample adds the
+ * rank-one term b*b', where b holds the m = supportedPrInterval() basis functions that are nonzero at x.
+ * A is stored sparse, with the pattern of all pairs of basis functions with overlapping support, so a sample
+ * costs O(m^2 log m) independently of the number of basis functions.
+ * With a forgetting factor lambda < 1, the normal equations are scaled by lambda before each sample is added,
+ * so that the weight of old samples (and of the smoothing term) decays exponentially. The scaling is accumulated
+ * in a scalar instead of being applied to A.
+ * The pattern of A is fixed, so its symbolic analysis (sparse LDLT) is done once when the fit is created.
+ * getCoefficients() redoes only the numeric factorization of A if samples were added since the last call, and solves.
+ */
+class SPLINTER_API BSpline::OnlineFit
+{
+public:
+    // Add the sample (x, y)
+    void addSample(const DataPoint &sample);
+    void addSample(const std::vector<double> &x, double y);
+    void addSample(const DenseVector &x, double y);
+
+    // Coefficients of the current least squares fit
+    DenseVector getCoefficients() const;
+
+    // B-spline with the coefficients of the current least squares fit
+    BSpline getBSpline() const;
+
+    // Number of samples that have been fitted (including the samples of the data table of the builder)
+    unsigned int getNumSamples() const { return _numSamples; }
+
+    double getForgettingFactor() const { return _forgettingFactor; }
+
+    // The factorization cannot be copied, so a copy analyzes the pattern of A again
+    OnlineFit(const OnlineFit &other);
+    OnlineFit &operator=(const OnlineFit &other);
+    OnlineFit(OnlineFit &&other) = default;
+    OnlineFit &operator=(OnlineFit &&other) = default;
+
+private:
+    OnlineFit(const BSpline &bspline, const SparseMatrix &A, const DenseVector &rhs, unsigned int numSamples, double forgettingFactor);
+
+    typedef Eigen::SimplicialLDLT<SparseMatrix> Factorization;
+
+    // Symbolic analysis of the (fixed) pattern of A, done when the fit is created or copied
+    void analyzePattern();
+
+    // Factorizes the normal equations numerically, unless they are unchanged since the last factorization
+    const Factorization &factorize() const;
+
+    BSpline _bspline; // B-spline with default coefficients
+    SparseMatrix _A; // Lower triangle of the normal equations, divided by _scale
+    DenseVector _rhs; // Right-hand side B'*y of the normal equations, divided by _scale
+    double _scale; // Accumulated forgetting
+    unsigned int _numSamples;
+    double _forgettingFactor;
+
+    // Factorization of _A (analyzed once), refactorized on demand when _factorized is false
+    std::unique_ptr<Factorization> _factorization;
+    mutable bool _factorized;
+
+    friend class BSpline::Builder;
+};
+
 // B-spline builder class
 class SPLINTER_API BSpline::Builder
 {
@@ -94,9 +206,50 @@ public:
         return *this;
     }
 
-    // Build B-spline
+    Builder& solver(Solver solver)
+    {
+        _solver = solver;
+        return *this;
+    }
+
+    // Relative residual tolerance of the iterative solvers
+    Builder& tolerance(double tolerance)
+    {
+        if (tolerance <= 0)
+            throw Exception("BSpline::Builder::tolerance: tolerance must be positive.");
+
+        _tolerance = tolerance;
+        return *this;
+    }
+
+    // Iteration limit of the iterative solvers
+    Builder& maxIterations(unsigned int maxIterations)
+    {
+        _maxIterations = maxIterations;
+        return *this;
+    }
+
+    // Build B-spline (throws if an iterative solver does not converge)
     BSpline build() const;
 
+    // Build B-spline and report the convergence of the solver
+    BSpline build(SolverStatistics &statistics) const;
+
+    // Build one B-spline per column of sample values in Y (rows ordered as the samples of the data table)
+    std::vector<BSpline> build(const DenseMatrix &Y) const;
+
+    // Build one B-spline per column of Y and report the worst convergence of the solver over the columns
+    std::vector<BSpline> build(const DenseMatrix &Y, SolverStatistics &statistics) const;
+
+    // Compute knots, basis matrix and factorization for repeated fits on the sample points of the data table
+    FitPlan plan() const;
+
+    /*
+     * Compute knots from the data table and start an online least squares fit of its samples, to which new
+     * samples can be added without refitting. The forgetting factor must be in (0, 1] (1 means no forgetting).
+     */
+    OnlineFit online(double forgettingFactor = 1.0) const;
+
 private:
     Builder();
 
@@ -108,12 +261,17 @@ private:
     }
 
     // Control point computations
-    DenseVector computeCoefficients(const BSpline &bspline) const;
-    DenseVector computeBSplineCoefficients(const BSpline &bspline) const;
+    FitPlan::CoefficientSolver prepareSolver(const BSpline &bspline) const;
+    FitPlan::CoefficientSolver prepareDirectSolver(const BSpline &bspline) const;
+    FitPlan::CoefficientSolver prepareKroneckerSolver(const BSpline &bspline) const;
+    FitPlan::CoefficientSolver prepareIterativeSolver(const BSpline &bspline) const;
     SparseMatrix computeBasisFunctionMatrix(const BSpline &bspline) const;
+    std::vector<DenseMatrix> computeBasisFunctionMatrices(const BSpline &bspline) const;
+    bool isGridWithoutDuplicates() const;
     DenseVector getSamplePointValues() const;
     // P-spline control point calculation
     SparseMatrix getSecondOrderFiniteDifferenceMatrix(const BSpline &bspline) const;
+    DenseMatrix getSecondOrderFiniteDifferenceMatrix(unsigned int n) const;
 
     // Computing knots
     std::vector<std::vector<double>> computeKnotVectors() const;
@@ -131,6 +289,9 @@ private:
     std::vector<unsigned int> _numBasisFunctions;
     KnotSpacing _knotSpacing;
     Smoothing _smoothing;
+    Solver _solver;
+    double _tolerance;
+    unsigned int _maxIterations;
     double _alpha;
 };
 
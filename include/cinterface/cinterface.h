@@ -174,6 +174,19 @@ SPLINTER_API void splinter_bspline_builder_set_alpha(splinter_obj_ptr bspline_bu
  */
 SPLINTER_API splinter_obj_ptr splinter_bspline_builder_build(splinter_obj_ptr bspline_builder_ptr);
 
+/**
+ * Build a VectorBSpline with one output per column of y, with the parameters of the Builder.
+ * The basis is computed and factorized once for all outputs.
+ *
+ * @param bspline_builder_ptr The Builder to "build the VectorBSpline with".
+ * @param y Row major num_samples x num_outputs array of sample values, with the rows in the order of the samples of
+ * the datatable of the Builder (sorted by x).
+ * @param num_samples Number of rows in y (must equal the number of samples in the datatable).
+ * @param num_outputs Number of columns in y.
+ * @return Pointer to the created VectorBSpline.
+ */
+SPLINTER_API splinter_obj_ptr splinter_bspline_builder_build_vector(splinter_obj_ptr bspline_builder_ptr, double *y, int num_samples, int num_outputs);
+
 /**
  * Free the memory of the internal Builder
  *
@@ -283,6 +296,20 @@ SPLINTER_API double *splinter_bspline_eval_jacobian_row_major(splinter_obj_ptr b
  */
 SPLINTER_API double *splinter_bspline_eval_hessian_row_major(splinter_obj_ptr bspline_ptr, double *x, int x_len);
 
+/**
+ * Evaluate the value and the derivatives up to the given order of a BSpline in one or more points,
+ * using a single evaluation of the basis functions per point.
+ * @see eval_row_major() for further explanation of the behaviour.
+ *
+ * @param bspline_ptr Pointer to the BSpline to evaluate.
+ * @param x Array of doubles. Is of x_len length.
+ * @param x_len Length of x.
+ * @param order Highest derivative order to evaluate (0, 1 or 2).
+ * @return Flattened array with one block per point in x: the value, followed by the jacobian if order >= 1
+ * and the hessian (in row major order) if order = 2.
+ */
+SPLINTER_API double *splinter_bspline_eval_all_row_major(splinter_obj_ptr bspline_ptr, double *x, int x_len, int order);
+
 /**
  * Evaluate the a BSpline in one or more points that are stored in column major order.
  * @see eval_row_major() for further explanation of the behaviour.
@@ -316,6 +343,18 @@ SPLINTER_API double *splinter_bspline_eval_jacobian_col_major(splinter_obj_ptr b
  */
 SPLINTER_API double *splinter_bspline_eval_hessian_col_major(splinter_obj_ptr bspline_ptr, double *x, int x_len);
 
+/**
+ * Evaluate the value and the derivatives up to the given order of a BSpline in one or more points that are stored in column major order.
+ * @see eval_all_row_major() for the layout of the results.
+ *
+ * @param bspline_ptr Pointer to the BSpline to evaluate.
+ * @param x Array of doubles. Is of x_len length.
+ * @param x_len Length of x.
+ * @param order Highest derivative order to evaluate (0, 1 or 2).
+ * @return Flattened array with one block per point in x.
+ */
+SPLINTER_API double *splinter_bspline_eval_all_col_major(splinter_obj_ptr bspline_ptr, double *x, int x_len, int order);
+
 /**
  * Get the number of variables (dimension) of a BSpline.
  *
@@ -351,6 +390,91 @@ SPLINTER_API void splinter_bspline_insert_knots(splinter_obj_ptr bspline_ptr, do
 
 SPLINTER_API void splinter_bspline_decompose_to_bezier_form(splinter_obj_ptr bspline_ptr);
 
+
+
+
+
+/**
+ * Load a VectorBSpline from file.
+ *
+ * @param filename The file to load the VectorBSpline from.
+ * @return Pointer to the loaded VectorBSpline.
+ */
+SPLINTER_API splinter_obj_ptr splinter_vector_bspline_load_init(const char *filename);
+
+/**
+ * Evaluate all outputs of a VectorBSpline in one or more points.
+ * @see splinter_bspline_eval_row_major() for further explanation of the behaviour.
+ *
+ * @param vector_bspline_ptr Pointer to the VectorBSpline to evaluate.
+ * @param x Array of doubles. Is of x_len length.
+ * @param x_len Length of x.
+ * @return Flattened array with the splinter_vector_bspline_get_num_outputs values of each point in x.
+ */
+SPLINTER_API double *splinter_vector_bspline_eval_row_major(splinter_obj_ptr vector_bspline_ptr, double *x, int x_len);
+
+/**
+ * Evaluate the jacobian of all outputs of a VectorBSpline in one or more points.
+ * @see splinter_bspline_eval_row_major() for further explanation of the behaviour.
+ *
+ * @param vector_bspline_ptr Pointer to the VectorBSpline to evaluate.
+ * @param x Array of doubles. Is of x_len length.
+ * @param x_len Length of x.
+ * @return Flattened array with one (num_outputs x num_variables) jacobian per point in x, stored in row major order.
+ */
+SPLINTER_API double *splinter_vector_bspline_eval_jacobian_row_major(splinter_obj_ptr vector_bspline_ptr, double *x, int x_len);
+
+/**
+ * Evaluate all outputs of a VectorBSpline in one or more points that are stored in column major order.
+ * @see splinter_vector_bspline_eval_row_major() for the layout of the results.
+ *
+ * @param vector_bspline_ptr Pointer to the VectorBSpline to evaluate.
+ * @param x Array of doubles. Is of x_len length.
+ * @param x_len Length of x.
+ * @return Flattened array of results.
+ */
+SPLINTER_API double *splinter_vector_bspline_eval_col_major(splinter_obj_ptr vector_bspline_ptr, double *x, int x_len);
+
+/**
+ * Evaluate the jacobian of all outputs of a VectorBSpline in one or more points that are stored in column major order.
+ * @see splinter_vector_bspline_eval_jacobian_row_major() for the layout of the results.
+ *
+ * @param vector_bspline_ptr Pointer to the VectorBSpline to evaluate.
+ * @param x Array of doubles. Is of x_len length.
+ * @param x_len Length of x.
+ * @return Flattened array of results.
+ */
+SPLINTER_API double *splinter_vector_bspline_eval_jacobian_col_major(splinter_obj_ptr vector_bspline_ptr, double *x, int x_len);
+
+/**
+ * Get the number of variables (dimension) of a VectorBSpline.
+ *
+ * @param vector_bspline_ptr Pointer to the VectorBSpline.
+ */
+SPLINTER_API int splinter_vector_bspline_get_num_variables(splinter_obj_ptr vector_bspline_ptr);
+
+/**
+ * Get the number of outputs of a VectorBSpline.
+ *
+ * @param vector_bspline_ptr Pointer to the VectorBSpline.
+ */
+SPLINTER_API int splinter_vector_bspline_get_num_outputs(splinter_obj_ptr vector_bspline_ptr);
+
+/**
+ * Save a VectorBSpline to file.
+ *
+ * @param vector_bspline_ptr Pointer to the VectorBSpline.
+ * @param filename File to save the VectorBSpline to (will be overwritten!).
+ */
+SPLINTER_API void splinter_vector_bspline_save(splinter_obj_ptr vector_bspline_ptr, const char *filename);
+
+/**
+ * Free the memory used by a VectorBSpline.
+ *
+ * @param vector_bspline_ptr Pointer to the VectorBSpline.
+ */
+SPLINTER_API void splinter_vector_bspline_delete(splinter_obj_ptr vector_bspline_ptr);
+
 #ifdef __cplusplus
     }
 #endif
@@ -14,6 +14,7 @@
 #include "function.h"
 #include "cinterface.h"
 #include "bspline.h"
+#include "vectorbspline.h"
 
 namespace SPLINTER
 {
@@ -24,6 +25,7 @@ namespace SPLINTER
 extern std::set<splinter_obj_ptr> dataTables;
 extern std::set<splinter_obj_ptr> bsplines;
 extern std::set<splinter_obj_ptr> bspline_builders;
+extern std::set<splinter_obj_ptr> vector_bsplines;
 
 extern int splinter_last_func_call_error; // Tracks the success of the last function call
 extern const char *splinter_error_string; // Error string (if the last function call resulted in an error)
@@ -36,6 +38,9 @@ DataTable *get_datatable(splinter_obj_ptr datatable_ptr);
 /* Check for existence of bspline_ptr, then cast splinter_obj_ptr to a BSpline * */
 BSpline *get_bspline(splinter_obj_ptr bspline_ptr);
 
+/* Check for existence of vector_bspline_ptr, then cast splinter_obj_ptr to a VectorBSpline * */
+VectorBSpline *get_vector_bspline(splinter_obj_ptr vector_bspline_ptr);
+
 /* Check for existence of bspline_builder_ptr, then cast splinter_obj_ptr to a BSpline::Builder * */
 BSpline::Builder *get_builder(splinter_obj_ptr bspline_builder_ptr);
 
@@ -67,6 +72,29 @@ DenseVector get_densevector(NUMERICAL_TYPE *x, size_t x_dim)
     return xvec;
 }
 
+/**
+ * Convert from a standard C array of points stored in row major order to a DenseMatrix with one point per row.
+ *
+ * @param x C array to convert from.
+ * @param num_points The number of points (rows) in x.
+ * @param x_dim The dimension of each point (columns) in x.
+ * @return DenseMatrix with the same data as x.
+ */
+template <class NUMERICAL_TYPE>
+DenseMatrix get_densematrix(NUMERICAL_TYPE *x, size_t num_points, size_t x_dim)
+{
+    DenseMatrix xmat(num_points, x_dim);
+    for (size_t i = 0; i < num_points; i++)
+    {
+        for (size_t j = 0; j < x_dim; j++)
+        {
+            xmat(i, j) = (double) x[i*x_dim + j];
+        }
+    }
+
+    return xmat;
+}
+
 /**
  * Convert from DenseVector to a vector of NUMERICAL_TYPE.
  * It must be possible to cast from double to NUMERICAL_TYPE.
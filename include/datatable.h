@@ -11,6 +11,10 @@
 #define SPLINTER_DATATABLE_H
 
 #include <set>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <atomic>
 #include "datapoint.h"
 
 #include <ostream>
@@ -18,9 +22,44 @@
 namespace SPLINTER
 {
 
+/*
+ * Options for importing samples with DataTable::fromCsv and DataTable::fromRaw
+ */
+struct ImportOptions
+{
+    bool allowDuplicates = false;
+    bool allowIncompleteGrid = false;
+
+    // CSV only: the value separator, and the number of lines to skip before the samples
+    char delimiter = ',';
+    unsigned int numHeaderLines = 0;
+
+    // The file is read and parsed in blocks of (about) this many bytes
+    size_t blockSize = 1 << 24;
+};
+
+/*
+ * Throughput of an import: numSamples samples (before duplicates are removed) were read from numBytes bytes in seconds
+ */
+struct ImportStatistics
+{
+    size_t numSamples = 0;
+    size_t numBytes = 0;
+    double seconds = 0;
+};
+
 /*
  * DataTable is a class for storing multidimensional data samples (x,y).
- * The samples are stored in a continuously sorted table.
+ * The samples are stored column by column, in one contiguous array per variable and one array of y-values.
+ * New samples are appended, and the table is sorted by x (and duplicates are removed) when the samples are
+ * first accessed in order. The grid (the sorted unique values of each variable) is built on demand.
+ *
+ * A table saved with saveColumnar is memory-mapped when loaded, and its samples are read from the file
+ * without copying. Adding samples to a mapped table copies the samples into memory first.
+ *
+ * Thread safety: the const member functions may be called concurrently (the lazy sorting and grid construction
+ * are done once, under a lock). Adding samples, loading or assigning the table must not overlap with any other
+ * access to it.
  */
 class SPLINTER_API DataTable
 {
@@ -29,10 +68,101 @@ public:
     DataTable(bool allowDuplicates);
     DataTable(bool allowDuplicates, bool allowIncompleteGrid);
     DataTable(const char *fileName);
-    DataTable(const std::string &fileName); // Load DataTable from file
+    DataTable(const std::string &fileName); // Load DataTable from file (saved with save or saveColumnar)
+
+    // Copies lock the other table, which may be sorted concurrently by its const member functions
+    DataTable(const DataTable &other);
+    DataTable &operator=(const DataTable &other);
+
+    /*
+     * Import samples from a CSV file with one sample per line: the values of the variables followed by the y-value.
+     * The file is streamed in blocks, the lines of a block are parsed in parallel (if OpenMP is enabled),
+     * and each block is added with addSamples. Empty lines are skipped. Numbers are read in the "C" locale
+     * (with '.' as the decimal separator), whatever the global locale is.
+     * The table is reserved from the file size, so the import needs about the table and one block of memory.
+     * The first access sorts the table, which temporarily needs about three more arrays of getNumSamples() elements.
+     */
+    static DataTable fromCsv(const std::string &fileName, const ImportOptions &options = ImportOptions());
+    static DataTable fromCsv(const std::string &fileName, const ImportOptions &options, ImportStatistics &statistics);
+
+    /*
+     * Import samples from a raw binary file of native doubles, with one record of numVariables x-values
+     * followed by the y-value per sample
+     */
+    static DataTable fromRaw(const std::string &fileName, unsigned int numVariables, const ImportOptions &options = ImportOptions());
+    static DataTable fromRaw(const std::string &fileName, unsigned int numVariables, const ImportOptions &options, ImportStatistics &statistics);
+
+    // Storage order of the sample points in addSamples
+    enum class Layout
+    {
+        ROW_MAJOR,      // X[j*numVariables + i] is variable i of sample j
+        COLUMN_MAJOR    // X[i*numSamples + j] is variable i of sample j
+    };
+
+    /*
+     * Lightweight reference to a sample of the table, which reads the sample from the columns on access.
+     * It converts to a DataPoint (a copy of the sample), and is invalidated by adding samples.
+     */
+    class SPLINTER_API SampleRef
+    {
+    public:
+        SampleRef(const DataTable *table, size_t index) : table(table), index(index) {}
+
+        unsigned int getDimX() const { return table->numVariables; }
+        double getX(unsigned int variable) const;
+        std::vector<double> getX() const;
+        double getY() const;
+
+        operator DataPoint() const;
+
+    private:
+        const DataTable *table;
+        size_t index;
+    };
+
+    /*
+     * Input iterator over the samples, sorted by x. Dereferencing gives a SampleRef to the current sample
+     * (by value, so no sample is copied unless it is converted to a DataPoint).
+     * Adding samples invalidates the iterators.
+     */
+    class SPLINTER_API const_iterator
+    {
+    public:
+        // Result of operator->, which holds the SampleRef that the member access is applied to
+        class ArrowProxy
+        {
+        public:
+            ArrowProxy(const SampleRef &ref) : ref(ref) {}
+            const SampleRef *operator->() const { return &ref; }
+
+        private:
+            SampleRef ref;
+        };
+
+        typedef std::input_iterator_tag iterator_category;
+        typedef DataPoint value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef ArrowProxy pointer;
+        typedef SampleRef reference;
+
+        const_iterator(const DataTable *table, size_t index) : table(table), index(index) {}
+
+        reference operator*() const { return SampleRef(table, index); }
+        pointer operator->() const { return ArrowProxy(**this); }
+
+        const_iterator &operator++();
+        const_iterator operator++(int);
+
+        bool operator==(const const_iterator &rhs) const { return index == rhs.index && table == rhs.table; }
+        bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
+
+    private:
+        const DataTable *table;
+        size_t index;
+    };
 
     /*
-     * Functions for adding a sample (x,y)
+     * Functions for adding a sample (x,y). The values of x must be finite (they are sorted and make up the grid).
      */
     void addSample(const DataPoint &sample);
     void addSample(double x, double y);
@@ -40,43 +170,112 @@ public:
     void addSample(DenseVector x, double y);
     void addSample(std::initializer_list<DataPoint> samples);
 
+    /*
+     * Add numSamples samples at once, with the sample points in X (numSamples x numVariables, in the given layout)
+     * and the y-values in y. The samples are appended, and sorted and checked for duplicates with the other
+     * samples added since the table was last accessed. The values of X must be finite; otherwise nothing is added.
+     */
+    void addSamples(const double *X, const double *y, size_t numSamples, unsigned int numVariables, Layout layout = Layout::ROW_MAJOR);
+
     /*
      * Getters
      */
-    std::multiset<DataPoint>::const_iterator cbegin() const;
-    std::multiset<DataPoint>::const_iterator cend() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
 
     unsigned int getNumVariables() const {return numVariables;}
-    unsigned int getNumSamples() const {return samples.size();}
-    const std::multiset<DataPoint>& getSamples() const {return samples;}
+    unsigned int getNumSamples() const;
+
+    // Sample number index (in sorted order)
+    DataPoint getSample(size_t index) const;
+
+    // The samples as a multiset (assembled on each call)
+    std::multiset<DataPoint> getSamples() const;
+
+    /*
+     * Columnar access to the samples, sorted by x: the values of one variable, and the y-values.
+     * The arrays have getNumSamples() elements and are invalidated by adding samples.
+     */
+    const double *getColumnX(unsigned int variable) const;
+    const double *getColumnY() const;
+
+    // Sorted unique values of each variable
+    const std::vector<std::vector<double>> &getGrid() const;
+
+    /*
+     * The index of the value of a variable in getGrid()[variable], for each sample (sorted by x).
+     * The array has getNumSamples() elements and is invalidated by adding samples.
+     */
+    const unsigned int *getGridIndices(unsigned int variable) const;
 
-    std::vector<std::set<double>> getGrid() const { return grid; }
     std::vector< std::vector<double> > getTableX() const;
     std::vector<double> getVectorY() const;
-    
+
     bool isGridComplete() const;
 
     void save(const std::string &fileName) const;
 
+    /*
+     * Save the sorted samples in the columnar binary format: a versioned header followed by one array per
+     * variable and the array of y-values, each aligned to 64 bytes. Loading such a file maps it into memory.
+     */
+    void saveColumnar(const std::string &fileName) const;
+
 private:
     bool allowDuplicates;
     bool allowIncompleteGrid;
-    unsigned int numDuplicates;
+    mutable unsigned int numDuplicates;
     unsigned int numVariables;
 
-    std::multiset<DataPoint> samples;
-    std::vector< std::set<double> > grid;
+    /*
+     * Columnar storage: the value of variable i in sample j is columns[i][j], and its y-value is values[j].
+     * The first numSorted samples are sorted (without discarded duplicates); the rest have been appended since.
+     * The storage is mutable since it is sorted on first (const) access.
+     */
+    mutable std::vector<std::vector<double>> columns;
+    mutable std::vector<double> values;
+    mutable size_t numSorted;
+
+    // Samples of a memory-mapped columnar file (shared by copies of the table), used instead of columns and values
+    struct MappedColumns;
+    std::shared_ptr<const MappedColumns> mapped;
+
+    // Storage accessors, which read the mapped file if the table is mapped
+    size_t getNumStored() const;
+    const double *getColumnData(unsigned int variable) const;
+    const double *getValueData() const;
+
+    // Copies the samples of a mapped file into columns and values, and releases the file (before adding samples)
+    void materialize();
+
+    // Grid values of each variable, built on demand, and the grid indices of the samples (built when first requested)
+    mutable std::vector< std::vector<double> > grid;
+    mutable std::vector< std::vector<unsigned int> > gridIndices;
 
-    void initDataStructures(); // Initialise grid to be a std::vector of xDim std::sets
+    /*
+     * The lazy sorting and grid construction are guarded by lazyMutex. The flags are set when they are done,
+     * and are checked without the lock. Adding samples clears them.
+     */
+    mutable std::recursive_mutex lazyMutex;
+    mutable std::atomic<bool> sorted;
+    mutable std::atomic<bool> gridBuilt;
+    mutable std::atomic<bool> gridIndicesBuilt;
+
+    void initDataStructures(); // Initialise one (empty) column per variable, keeping reserved memory
     unsigned int getNumSamplesRequired() const;
 
-    void recordGridPoint(const DataPoint &sample);
+    // Sorts the appended samples into the table, removing or counting duplicates
+    void sortSamples() const;
+
+    void buildGrid() const;
+    void buildGridIndices() const;
 
     // Used by functions that require the grid to be complete before they start their operation
     // This function prints a message and exits the program if the grid is not complete.
     void gridCompleteGuard() const;
 
     void load(const std::string &fileName);
+    void loadColumnar(const std::string &fileName);
 
     friend class Serializer;
     friend bool operator==(const DataTable &lhs, const DataTable &rhs);
@@ -0,0 +1,59 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#ifndef SPLINTER_ITERATIVESOLVERS_H
+#define SPLINTER_ITERATIVESOLVERS_H
+
+#include "definitions.h"
+#include <functional>
+
+namespace SPLINTER
+{
+
+/*
+ * A rows x cols matrix that is only available through its products with vectors,
+ * e.g. a Kronecker product or a sum of such products.
+ */
+struct LinearOperator
+{
+    int rows;
+    int cols;
+    std::function<DenseVector(const DenseVector &)> apply;          // x -> A*x
+    std::function<DenseVector(const DenseVector &)> applyTranspose; // y -> A'*y
+};
+
+// Convergence report of a linear solve (iterations is 0 for direct solvers)
+struct SolverStatistics
+{
+    unsigned int iterations = 0;
+    double relativeResidual = 0; // ||A'*(b - A*x)||/||A'*b|| for least squares, ||b - A*x||/||b|| for CG
+    bool converged = true;
+};
+
+/*
+ * Least squares solvers for min ||A*x - b||, with a right preconditioner R^-1 given as the operator
+ * (apply: y -> R^-1*y, applyTranspose: z -> R^-T*z), where R'*R approximates A'*A.
+ * The iterations stop when ||A'*(b - A*x)|| <= tolerance*||A'*b|| (measured for the preconditioned system).
+ */
+DenseVector solveLSQR(const LinearOperator &A, const DenseVector &b, const LinearOperator &preconditioner,
+                      double tolerance, unsigned int maxIterations, SolverStatistics &statistics);
+
+DenseVector solveCGLS(const LinearOperator &A, const DenseVector &b, const LinearOperator &preconditioner,
+                      double tolerance, unsigned int maxIterations, SolverStatistics &statistics);
+
+/*
+ * Preconditioned conjugate gradients for A*x = b with A symmetric positive definite, where the preconditioner
+ * applies M^-1 (symmetric positive definite). Starts from x0 and stops when ||b - A*x|| <= tolerance*||b||.
+ */
+DenseVector solveCG(const LinearOperator &A, const DenseVector &b, const LinearOperator &preconditioner, const DenseVector &x0,
+                    double tolerance, unsigned int maxIterations, SolverStatistics &statistics);
+
+} // namespace SPLINTER
+
+#endif // SPLINTER_ITERATIVESOLVERS_H
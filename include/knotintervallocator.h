@@ -0,0 +1,65 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#ifndef SPLINTER_KNOTINTERVALLOCATOR_H
+#define SPLINTER_KNOTINTERVALLOCATOR_H
+
+#include <vector>
+
+namespace SPLINTER
+{
+
+/*
+ * Finds the knot interval containing a point, i.e. the index u such that knots[u] <= x < knots[u+1]
+ * (or the index of the last knot if x equals the last knot).
+ * The locator is built once per knot vector. Uniformly spaced knot values are located with O(1) arithmetic.
+ * Other knot vectors are searched branch-free in an Eytzinger (breadth-first) layout of the distinct knot values.
+ */
+class KnotIntervalLocator
+{
+public:
+    KnotIntervalLocator();
+    KnotIntervalLocator(const std::vector<double> &knots);
+
+    // Requires knots.front() <= x <= knots.back()
+    int find(double x) const;
+
+    // As find, but starts with a galloping search from the interval hint (e.g. the result of the previous query)
+    int find(double x, int hint) const
+    {
+        if (hint >= 0 && hint + 1 < (int)knots.size() && knots[hint] <= x && x < knots[hint + 1])
+            return hint;
+
+        return findFromHint(x, hint);
+    }
+
+    bool isUniform() const { return uniform; }
+
+private:
+    std::vector<double> knots;
+
+    // Distinct knot values and, for each of them, the index of its last occurrence in knots
+    std::vector<double> distinct;
+    std::vector<int> lastIndex;
+
+    // Distinct knot values in Eytzinger layout (1-based) and their positions in distinct
+    std::vector<double> eytzinger;
+    std::vector<int> eytzingerPosition;
+
+    bool uniform;
+    double invSpacing;
+
+    int findDistinct(double x) const;
+    int findFromHint(double x, int hint) const;
+    int buildEytzinger(int i, int k);
+};
+
+} // namespace SPLINTER
+
+#endif // SPLINTER_KNOTINTERVALLOCATOR_H
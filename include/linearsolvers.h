@@ -168,6 +168,95 @@ private:
     }
 };
 
+/*
+ * Linear solver that keeps the factorization of A, so that A*X = B can be solved for new right-hand sides
+ * (one or more columns in B) without factorizing A again.
+ */
+template<class lhs>
+class LinearFactorization
+{
+public:
+    bool factorize(const lhs &A)
+    {
+        rows = A.rows();
+        return doFactorize(A);
+    }
+
+    DenseMatrix solve(const DenseMatrix &B) const
+    {
+        if (B.rows() != rows)
+            throw Exception("LinearFactorization::solve: Inconsistent matrix dimensions!");
+
+        return doSolve(B);
+    }
+
+    virtual ~LinearFactorization() {}
+private:
+    int rows = 0;
+
+    virtual bool doFactorize(const lhs &A) = 0;
+    virtual DenseMatrix doSolve(const DenseMatrix &B) const = 0;
+};
+
+// Least squares solutions for rectangular matrices
+class DenseQRFactorization : public LinearFactorization<DenseMatrix>
+{
+private:
+    Eigen::ColPivHouseholderQR<DenseMatrix> qr;
+
+    bool doFactorize(const DenseMatrix &A)
+    {
+        qr.compute(A);
+        return qr.info() == Eigen::Success;
+    }
+
+    DenseMatrix doSolve(const DenseMatrix &B) const
+    {
+        return qr.solve(B);
+    }
+};
+
+// Requires square matrices
+class SparseLUFactorization : public LinearFactorization<SparseMatrix>
+{
+private:
+    Eigen::SparseLU<SparseMatrix> lu;
+
+    bool doFactorize(const SparseMatrix &A)
+    {
+        if (A.rows() != A.cols())
+            return false;
+
+        lu.analyzePattern(A);
+        lu.factorize(A);
+        return lu.info() == Eigen::Success;
+    }
+
+    DenseMatrix doSolve(const DenseMatrix &B) const
+    {
+        return lu.solve(B);
+    }
+};
+
+// Least squares solutions for rectangular matrices
+class SparseQRFactorization : public LinearFactorization<SparseMatrix>
+{
+private:
+    Eigen::SparseQR<SparseMatrix, Eigen::COLAMDOrdering<int>> qr;
+
+    bool doFactorize(const SparseMatrix &A)
+    {
+        qr.analyzePattern(A);
+        qr.factorize(A);
+        return qr.info() == Eigen::Success;
+    }
+
+    DenseMatrix doSolve(const DenseMatrix &B) const
+    {
+        return qr.solve(B);
+    }
+};
+
 } // namespace SPLINTER
 
 #endif // SPLINTER_LINEARSOLVER_H
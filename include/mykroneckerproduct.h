@@ -22,6 +22,48 @@ SparseVector kroneckerProductVectors(const std::vector<SparseVector> &vectors);
 DenseVector kroneckerProductVectors(const std::vector<DenseVector> &vectors);
 SparseMatrix kroneckerProductMatrices(const std::vector<SparseMatrix> &matrices);
 
+/*
+ * Computes (A_0 x A_1 x ... x A_(d-1))*x without forming the Kronecker product. x is viewed as a tensor
+ * with dimensions cols(A_0), ..., cols(A_(d-1)), where the first index varies slowest, and each factor
+ * is applied along its own mode. The cost is O(size(x)*sum_i rows(A_i)) for square factors.
+ */
+DenseVector kroneckerProductApply(const std::vector<DenseMatrix> &factors, const DenseVector &x);
+
+// Computes (A_0 x A_1 x ... x A_(d-1))*X for all columns of X at once
+DenseMatrix kroneckerProductApply(const std::vector<DenseMatrix> &factors, const DenseMatrix &X);
+
+// Applies A along the given mode of x, viewed as a tensor with the given dimensions (the first index varies slowest)
+DenseVector kroneckerModeProduct(const DenseMatrix &A, unsigned int mode, const std::vector<int> &dims, const DenseVector &x);
+DenseVector kroneckerModeProduct(const SparseMatrix &A, unsigned int mode, const std::vector<int> &dims, const DenseVector &x);
+
+/*
+ * Lazy Kronecker product A_0 x A_1 x ... x A_(d-1) of sparse factors, e.g. a knot insertion matrix.
+ * Products with dense matrices apply one factor per mode (skipping identity factors) without forming the product,
+ * which for d variables has prod_i nnz(A_i) nonzeros.
+ */
+class KroneckerOperator
+{
+public:
+    KroneckerOperator(const std::vector<SparseMatrix> &factors);
+
+    int rows() const;
+    int cols() const;
+
+    const std::vector<SparseMatrix> &getFactors() const { return factors; }
+
+    KroneckerOperator transpose() const;
+
+    // Computes (A_0 x ... x A_(d-1))*X
+    DenseMatrix operator*(const DenseMatrix &X) const;
+
+    // Forms the Kronecker product
+    SparseMatrix toSparse() const;
+
+private:
+    std::vector<SparseMatrix> factors;
+    std::vector<bool> identity; // Factors that are identity matrices
+};
+
 } // namespace SPLINTER
 
 #endif // SPLINTER_MYKRONECKERPRODUCT_H
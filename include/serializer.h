@@ -24,6 +24,7 @@ namespace SPLINTER
 class DataPoint;
 class DataTable;
 class BSpline;
+class VectorBSpline;
 class BSplineBasis;
 class BSplineBasis1D;
 
@@ -65,6 +66,7 @@ public:
     void deserialize(DataPoint &obj);
     void deserialize(DataTable &obj);
     void deserialize(BSpline &obj);
+    void deserialize(VectorBSpline &obj);
     void deserialize(BSplineBasis &obj);
     void deserialize(BSplineBasis1D &obj);
 
@@ -94,10 +96,23 @@ public:
     static size_t get_size(const DataPoint &obj);
     static size_t get_size(const DataTable &obj);
     static size_t get_size(const BSpline &obj);
+    static size_t get_size(const VectorBSpline &obj);
     static size_t get_size(const BSplineBasis &obj);
     static size_t get_size(const BSplineBasis1D &obj);
 
 protected:
+    /*
+     * Format tags (a magic number and a version) written in front of the objects whose stored layout has changed,
+     * and of the objects introduced with the tags.
+     * Objects saved before the tags were introduced have no tag and are read as version 1 (if untaggedVersion1
+     * is true, and rejected otherwise). deserialize_format_tag reads the tag and returns the version, or throws if
+     * the version is newer than currentVersion or the tag belongs to another type.
+     */
+    static size_t get_format_tag_size();
+    void _serialize_format_tag(uint32_t magic, uint32_t version);
+    uint32_t deserialize_format_tag(uint32_t magic, uint32_t currentVersion, const std::string &typeName,
+                                    bool untaggedVersion1 = true);
+
     template <class T>
     void _serialize(const T &obj);
 
@@ -118,9 +133,13 @@ protected:
     void _serialize(const DataPoint &obj);
     void _serialize(const DataTable &obj);
     void _serialize(const BSpline &obj);
+    void _serialize(const VectorBSpline &obj);
     void _serialize(const BSplineBasis &obj);
     void _serialize(const BSplineBasis1D &obj);
 
+    // Writes size doubles in the layout of a std::vector<double>
+    void _serialize_array(const double *data, size_t size);
+
     typedef std::vector<uint8_t> StreamType;
     StreamType stream;
 
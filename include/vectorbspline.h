@@ -0,0 +1,125 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#ifndef SPLINTER_VECTORBSPLINE_H
+#define SPLINTER_VECTORBSPLINE_H
+
+#include "bspline.h"
+#include "bsplinebasis.h"
+#include "saveable.h"
+
+namespace SPLINTER
+{
+
+/**
+ * Vector-valued tensor product B-spline with numOutputs outputs sharing the basis (knot vectors and degrees).
+ * The basis functions supported at a point are evaluated once, and all outputs follow from a small dense
+ * product with the coefficients of the supported basis functions.
+ */
+class SPLINTER_API VectorBSpline : public Saveable
+{
+public:
+    /**
+     * Construct from the numBasisFunctions x numOutputs coefficient matrix, knot vectors, and basis degrees
+     */
+    VectorBSpline(const DenseMatrix &coefficients, std::vector< std::vector<double> > knotVectors, std::vector<unsigned int> basisDegrees);
+
+    /**
+     * Construct from B-splines with the same knot vectors and basis degrees (one output per B-spline),
+     * e.g. the B-splines returned by BSpline::Builder::build(Y)
+     */
+    VectorBSpline(const std::vector<BSpline> &bsplines);
+
+    /**
+     * Construct from file
+     */
+    VectorBSpline(const char *fileName);
+    VectorBSpline(const std::string &fileName);
+
+    // Returns the numOutputs values at x
+    DenseVector eval(const DenseVector &x) const;
+
+    // Returns the (numOutputs x numVariables) Jacobian evaluated at x
+    DenseMatrix evalJacobian(const DenseVector &x) const;
+
+    /*
+     * Allocation-free evaluation at the numVariables values in x: values receives the numOutputs values,
+     * and jacobian the numOutputs x numVariables Jacobian in column-major order
+     */
+    void eval(const double *x, double *values) const;
+    void evalJacobian(const double *x, double *jacobian) const;
+
+    /**
+     * Getters
+     */
+    unsigned int getNumVariables() const
+    {
+        return numVariables;
+    }
+
+    unsigned int getNumOutputs() const
+    {
+        return coefficients.rows();
+    }
+
+    unsigned int getNumBasisFunctions() const
+    {
+        return basis.getNumBasisFunctions();
+    }
+
+    // Returns the numBasisFunctions x numOutputs coefficient matrix
+    DenseMatrix getCoefficients() const
+    {
+        return coefficients.transpose();
+    }
+
+    // Returns the scalar B-spline of one output
+    BSpline getOutput(unsigned int output) const;
+
+    std::vector< std::vector<double>> getKnotVectors() const;
+    std::vector<unsigned int> getBasisDegrees() const;
+    std::vector<double> getDomainUpperBound() const;
+    std::vector<double> getDomainLowerBound() const;
+
+    /**
+     * Setters
+     */
+    void setCoefficients(const DenseMatrix &coefficients);
+
+    void save(const std::string &fileName) const override;
+
+private:
+    VectorBSpline();
+
+    BSplineBasis basis;
+    unsigned int numVariables;
+
+    /*
+     * Coefficients stored as numOutputs x numBasisFunctions, so that the coefficients of all outputs
+     * of a basis function are contiguous (column j belongs to basis function j).
+     */
+    DenseMatrix coefficients;
+
+    /*
+     * Writes the outputs at x to values, and if jacobian is not null, the Jacobian (column-major) to jacobian.
+     * Both are zero outside the support (the eval functions reject such points in debug builds, as BSpline does).
+     */
+    void evalSupported(const double *x, double *values, double *jacobian) const;
+
+    bool pointInDomain(const double *x) const;
+
+    void load(const std::string &fileName) override;
+
+    friend class Serializer;
+    friend bool operator==(const VectorBSpline &lhs, const VectorBSpline &rhs);
+};
+
+} // namespace SPLINTER
+
+#endif // SPLINTER_VECTORBSPLINE_H
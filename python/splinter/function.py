@@ -57,6 +57,26 @@ class Function(object):
                     hessians[i][j].append(hes[i * self._num_variables * self._num_variables + j * self._num_variables + k])
         return hessians
 
+    def eval_all(self, x, order=2):
+        x = self._transform_input(x)
+
+        n = self._num_variables
+        num_points = len(x) // n
+        res = splinter._call(splinter._get_handle().splinter_bspline_eval_all_row_major, self._handle, (c_double * len(x))(*x), len(x), order)
+
+        # Each point has a block with the value, the jacobian (order >= 1) and the hessian (order == 2)
+        block_size = 1 + (n if order >= 1 else 0) + (n * n if order >= 2 else 0)
+        results = []
+        for i in range(num_points):
+            block = res[i * block_size:(i + 1) * block_size]
+            result = [block[0]]
+            if order >= 1:
+                result.append(block[1:1 + n])
+            if order >= 2:
+                result.append([block[1 + n + j * n:1 + n + (j + 1) * n] for j in range(n)])
+            results.append(result)
+        return results
+
     def get_num_variables(self):
         return splinter._call(splinter._get_handle().splinter_bspline_get_num_variables, self._handle)
 
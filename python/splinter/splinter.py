@@ -121,6 +121,9 @@ def __init():
     _get_handle().splinter_bspline_builder_build.restype = handle_type
     _get_handle().splinter_bspline_builder_build.argtypes = [handle_type]
 
+    _get_handle().splinter_bspline_builder_build_vector.restype = handle_type
+    _get_handle().splinter_bspline_builder_build_vector.argtypes = [handle_type, c_double_p, c_int, c_int]
+
     _get_handle().splinter_bspline_builder_delete.restype = None
     _get_handle().splinter_bspline_builder_delete.argtypes = [handle_type]
 
@@ -154,6 +157,9 @@ def __init():
     _get_handle().splinter_bspline_eval_hessian_row_major.restype = c_double_p
     _get_handle().splinter_bspline_eval_hessian_row_major.argtypes = [handle_type, c_double_p, c_int]
 
+    _get_handle().splinter_bspline_eval_all_row_major.restype = c_double_p
+    _get_handle().splinter_bspline_eval_all_row_major.argtypes = [handle_type, c_double_p, c_int, c_int]
+
     _get_handle().splinter_bspline_get_num_variables.restype = c_int
     _get_handle().splinter_bspline_get_num_variables.argtypes = [handle_type]
 
@@ -169,6 +175,34 @@ def __init():
     _get_handle().splinter_bspline_decompose_to_bezier_form.restype = None
     _get_handle().splinter_bspline_decompose_to_bezier_form.argtypes = [handle_type]
 
+    # VectorBSpline
+    _get_handle().splinter_vector_bspline_load_init.restype = handle_type
+    _get_handle().splinter_vector_bspline_load_init.argtypes = [c_char_p]
+
+    _get_handle().splinter_vector_bspline_eval_row_major.restype = c_double_p
+    _get_handle().splinter_vector_bspline_eval_row_major.argtypes = [handle_type, c_double_p, c_int]
+
+    _get_handle().splinter_vector_bspline_eval_jacobian_row_major.restype = c_double_p
+    _get_handle().splinter_vector_bspline_eval_jacobian_row_major.argtypes = [handle_type, c_double_p, c_int]
+
+    _get_handle().splinter_vector_bspline_eval_col_major.restype = c_double_p
+    _get_handle().splinter_vector_bspline_eval_col_major.argtypes = [handle_type, c_double_p, c_int]
+
+    _get_handle().splinter_vector_bspline_eval_jacobian_col_major.restype = c_double_p
+    _get_handle().splinter_vector_bspline_eval_jacobian_col_major.argtypes = [handle_type, c_double_p, c_int]
+
+    _get_handle().splinter_vector_bspline_get_num_variables.restype = c_int
+    _get_handle().splinter_vector_bspline_get_num_variables.argtypes = [handle_type]
+
+    _get_handle().splinter_vector_bspline_get_num_outputs.restype = c_int
+    _get_handle().splinter_vector_bspline_get_num_outputs.argtypes = [handle_type]
+
+    _get_handle().splinter_vector_bspline_save.restype = None
+    _get_handle().splinter_vector_bspline_save.argtypes = [handle_type, c_char_p]
+
+    _get_handle().splinter_vector_bspline_delete.restype = None
+    _get_handle().splinter_vector_bspline_delete.argtypes = [handle_type]
+
 
 # Try to locate SPLINTER relative to this script
 # Assumes the Python interface of splinter has the following directory structure:
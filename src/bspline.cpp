@@ -10,10 +10,10 @@
 #include "bspline.h"
 #include "bsplinebasis.h"
 #include "mykroneckerproduct.h"
-#include "unsupported/Eigen/KroneckerProduct"
 #include <linearsolvers.h>
 #include <serializer.h>
 #include <iostream>
+#include <algorithm>
 #include <utilities.h>
 
 namespace SPLINTER
@@ -78,9 +78,13 @@ BSpline::BSpline(const std::string &fileName)
 double BSpline::eval(DenseVector x) const
 {
     checkInput(x);
-    // NOTE: casting to DenseVector to allow accessing as res(0)
-    DenseVector res = coefficients.transpose()*evalBasis(x);
-    return res(0);
+
+    #ifndef NDEBUG
+    if (!pointInDomain(x))
+        throw Exception("BSpline::eval: Evaluation at point outside domain.");
+    #endif // NDEBUG
+
+    return basis.evalContracted(coefficients, x.data());
 }
 
 /**
@@ -89,7 +93,15 @@ double BSpline::eval(DenseVector x) const
 DenseMatrix BSpline::evalJacobian(DenseVector x) const
 {
     checkInput(x);
-    return coefficients.transpose()*evalBasisJacobian(x);
+
+    #ifndef NDEBUG
+    if (!pointInDomain(x))
+        throw Exception("BSpline::evalJacobian: Evaluation at point outside domain.");
+    #endif // NDEBUG
+
+    DenseMatrix jacobian(1, numVariables);
+    basis.evalGradientContracted(coefficients, x.data(), jacobian.data());
+    return jacobian;
 }
 
 /*
@@ -106,21 +118,195 @@ DenseMatrix BSpline::evalHessian(DenseVector x) const
         throw Exception("BSpline::evalHessian: Evaluation at point outside domain.");
     #endif // NDEBUG
 
-    DenseMatrix H;
-    H.setZero(1,1);
-    DenseMatrix identity = DenseMatrix::Identity(numVariables, numVariables);
-    DenseMatrix caug = kroneckerProduct(identity, coefficients.transpose());
-    DenseMatrix DB = basis.evalBasisHessian(x);
-    H = caug*DB;
-
-    // Fill in upper triangular of Hessian
-    for (size_t i = 0; i < numVariables; ++i)
-        for (size_t j = i+1; j < numVariables; ++j)
-            H(i,j) = H(j,i);
+    DenseMatrix H(numVariables, numVariables);
+    basis.evalHessianContracted(coefficients, x.data(), H.data());
 
     return H;
 }
 
+/*
+ * Returns the value, Jacobian and Hessian at x, computed in one pass over the basis functions.
+ * Derivatives above the requested order are left empty.
+ */
+BSpline::Evaluation BSpline::evalAll(DenseVector x, unsigned int order) const
+{
+    checkInput(x);
+
+    if (order > 2)
+        throw Exception("BSpline::evalAll: Derivatives of order higher than 2 are not supported.");
+
+    #ifndef NDEBUG
+    if (!pointInDomain(x))
+        throw Exception("BSpline::evalAll: Evaluation at point outside domain.");
+    #endif // NDEBUG
+
+    Evaluation evaluation;
+    if (order >= 1)
+        evaluation.jacobian.resize(1, numVariables);
+    if (order >= 2)
+        evaluation.hessian.resize(numVariables, numVariables);
+
+    evaluation.value = basis.evalAllContracted(coefficients, x.data(), order,
+                                               evaluation.jacobian.data(), evaluation.hessian.data());
+
+    return evaluation;
+}
+
+// Number of points evaluated together by the batch evaluation routines
+static const int BATCH_CHUNK_SIZE = 256;
+
+/*
+ * Scratch buffers of the batch evaluation routines. They are kept per thread and only grow,
+ * so repeated (small) batches do not allocate.
+ */
+struct BatchWorkspace
+{
+    std::vector<double> xs;
+    std::vector<char> inside;
+    std::vector<double> values;
+    std::vector<double> derivatives;
+    std::vector<unsigned int> first;
+    std::vector<const double *> weights;
+    std::vector<const double *> derivativeWeights;
+    std::vector<double> lb;
+    std::vector<double> ub;
+};
+
+static thread_local BatchWorkspace batchWorkspace;
+
+template<class T>
+static T *growBuffer(std::vector<T> &buffer, size_t size)
+{
+    if (buffer.size() < size)
+        buffer.resize(size);
+    return buffer.data();
+}
+
+// Domain bounds of the basis, written to the workspace without temporary vectors
+static void loadBatchBounds(const BSplineBasis &basis, unsigned int numVariables, BatchWorkspace &workspace)
+{
+    growBuffer(workspace.lb, numVariables);
+    growBuffer(workspace.ub, numVariables);
+
+    for (unsigned int dim = 0; dim < numVariables; dim++)
+    {
+        workspace.lb[dim] = basis.getKnotValue(dim, 0);
+        workspace.ub[dim] = basis.getKnotValue(dim, basis.getNumBasisFunctions(dim) + basis.getBasisDegree(dim));
+    }
+}
+
+void BSpline::evalBatch(const DenseMatrix &X, Eigen::Ref<DenseVector> out) const
+{
+    if (X.cols() != numVariables)
+        throw Exception("BSpline::evalBatch: Wrong dimension on evaluation points X.");
+    if (out.size() != X.rows())
+        throw Exception("BSpline::evalBatch: Incompatible size of output vector.");
+
+    // Scratch buffers reused for all chunks of points
+    unsigned int numSupported = basis.getNumSupportedValues();
+    BatchWorkspace &workspace = batchWorkspace;
+    double *xs = growBuffer(workspace.xs, BATCH_CHUNK_SIZE*numVariables);
+    char *inside = growBuffer(workspace.inside, BATCH_CHUNK_SIZE);
+    double *values = growBuffer(workspace.values, BATCH_CHUNK_SIZE*numSupported);
+    unsigned int *first = growBuffer(workspace.first, BATCH_CHUNK_SIZE*numVariables);
+    const double **weights = growBuffer(workspace.weights, numVariables);
+    loadBatchBounds(basis, numVariables, workspace);
+
+    for (int start = 0; start < X.rows(); start += BATCH_CHUNK_SIZE)
+    {
+        int count = std::min((int)X.rows() - start, BATCH_CHUNK_SIZE);
+
+        loadBatchPoints(X, start, count, workspace.lb.data(), workspace.ub.data(), xs, inside);
+        basis.evalSupportedBatch(xs, count, values, first);
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (!inside[i])
+            {
+                out(start + i) = 0;
+                continue;
+            }
+
+            for (unsigned int dim = 0, offset = i*numSupported; dim < numVariables; dim++)
+            {
+                weights[dim] = values + offset;
+                offset += basis.getBasisDegree(dim) + 1;
+            }
+
+            out(start + i) = basis.contract(coefficients, weights, first + i*numVariables);
+        }
+    }
+}
+
+void BSpline::evalJacobianBatch(const DenseMatrix &X, Eigen::Ref<DenseMatrix> out) const
+{
+    if (X.cols() != numVariables)
+        throw Exception("BSpline::evalJacobianBatch: Wrong dimension on evaluation points X.");
+    if (out.rows() != X.rows() || out.cols() != numVariables)
+        throw Exception("BSpline::evalJacobianBatch: Incompatible size of output matrix.");
+
+    // Scratch buffers reused for all chunks of points
+    unsigned int numSupported = basis.getNumSupportedValues();
+    BatchWorkspace &workspace = batchWorkspace;
+    double *xs = growBuffer(workspace.xs, BATCH_CHUNK_SIZE*numVariables);
+    char *inside = growBuffer(workspace.inside, BATCH_CHUNK_SIZE);
+    double *values = growBuffer(workspace.values, BATCH_CHUNK_SIZE*numSupported);
+    double *derivatives = growBuffer(workspace.derivatives, BATCH_CHUNK_SIZE*numSupported);
+    unsigned int *first = growBuffer(workspace.first, BATCH_CHUNK_SIZE*numVariables);
+    const double **weights = growBuffer(workspace.weights, numVariables);
+    const double **derivativeWeights = growBuffer(workspace.derivativeWeights, numVariables);
+    loadBatchBounds(basis, numVariables, workspace);
+
+    for (int start = 0; start < X.rows(); start += BATCH_CHUNK_SIZE)
+    {
+        int count = std::min((int)X.rows() - start, BATCH_CHUNK_SIZE);
+
+        loadBatchPoints(X, start, count, workspace.lb.data(), workspace.ub.data(), xs, inside);
+        basis.evalSupportedBatch(xs, count, values, first);
+        basis.evalSupportedBatch(xs, count, derivatives, first, 1);
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (!inside[i])
+            {
+                out.row(start + i).setZero();
+                continue;
+            }
+
+            for (unsigned int dim = 0, offset = i*numSupported; dim < numVariables; dim++)
+            {
+                weights[dim] = values + offset;
+                derivativeWeights[dim] = derivatives + offset;
+                offset += basis.getBasisDegree(dim) + 1;
+            }
+
+            // The gradient is written to the (strided) output row in place
+            double gradient[MAX_CONTRACTION_VARIABLES];
+            basis.contractGradient(coefficients, weights, derivativeWeights, first + i*numVariables, gradient);
+            for (unsigned int dim = 0; dim < numVariables; dim++)
+                out(start + i, dim) = gradient[dim];
+        }
+    }
+}
+
+void BSpline::loadBatchPoints(const DenseMatrix &X, int start, int count, const double *lb, const double *ub,
+                              double *xs, char *inside) const
+{
+    for (int i = 0; i < count; ++i)
+    {
+        inside[i] = true;
+        for (unsigned int dim = 0; dim < numVariables; dim++)
+        {
+            double x = X(start + i, dim);
+            if (!(lb[dim] <= x && x <= ub[dim]))
+                inside[i] = false;
+        }
+
+        for (unsigned int dim = 0; dim < numVariables; dim++)
+            xs[dim*count + i] = inside[i] ? X(start + i, dim) : lb[dim];
+    }
+}
+
 // Evaluation of B-spline basis functions
 SparseVector BSpline::evalBasis(DenseVector x) const
 {
@@ -139,11 +325,7 @@ SparseMatrix BSpline::evalBasisJacobian(DenseVector x) const
         throw Exception("BSpline::evalBasisJacobian: Evaluation at point outside domain.");
     #endif // NDEBUG
 
-    //SparseMatrix Bi = basis.evalBasisJacobian(x);       // Sparse Jacobian implementation
-    //SparseMatrix Bi = basis.evalBasisJacobian2(x);  // Sparse Jacobian implementation
-    DenseMatrix Bi = basis.evalBasisJacobianOld(x);  // Old Jacobian implementation
-
-    return Bi.sparseView();
+    return basis.evalBasisJacobian(x);
 }
 
 std::vector<unsigned int> BSpline::getNumBasisFunctionsPerVariable() const
@@ -179,7 +361,7 @@ DenseMatrix BSpline::getControlPoints() const
     int nc = coefficients.size();
     DenseMatrix controlPoints(nc, numVariables + 1);
 
-    controlPoints.block(0, 0, nc, numVariables) = knotaverages;
+    controlPoints.block(0, 0, nc, numVariables) = expandKnotAverages();
     controlPoints.block(0, numVariables, nc, 1) = coefficients;
 
     return controlPoints;
@@ -194,33 +376,57 @@ void BSpline::setCoefficients(const DenseVector &coefficients)
     checkControlPoints();
 }
 
+/*
+ * The x-coordinates of the control points are the knot averages of the basis, so only the coefficients
+ * (the last column) can be set. The first numVariables columns must equal the knot averages.
+ */
 void BSpline::setControlPoints(const DenseMatrix &controlPoints)
 {
     if (controlPoints.cols() != numVariables + 1)
         throw Exception("BSpline::setControlPoints: Incompatible size of control point matrix.");
 
-    int nc = controlPoints.rows();
+    if (controlPoints.rows() != getNumBasisFunctions())
+        throw Exception("BSpline::setControlPoints: Incompatible size of control point matrix.");
+
+    DenseMatrix averages = expandKnotAverages();
+    double tolerance = 1e-12*std::max(1.0, averages.cwiseAbs().maxCoeff());
+    if ((controlPoints.leftCols(numVariables) - averages).cwiseAbs().maxCoeff() > tolerance)
+        throw Exception("BSpline::setControlPoints: The control point x-coordinates must equal the knot averages of the basis.");
 
-    knotaverages = controlPoints.block(0, 0, nc, numVariables);
-    coefficients = controlPoints.block(0, numVariables, nc, 1);
+    coefficients = controlPoints.col(numVariables);
 
     checkControlPoints();
 }
 
-void BSpline::updateControlPoints(const DenseMatrix &A)
+/*
+ * Applies the knot insertion (or support reduction) matrix A to the coefficients, viewed as a tensor with one mode
+ * per variable, one 1-D factor at a time (identity factors, e.g. of variables without new knots, are skipped).
+ * The knot averages of the new basis are recomputed from its knot vectors (the control point x-coordinates
+ * equal A times the old ones, since knot insertion reproduces linear functions exactly).
+ */
+void BSpline::updateControlPoints(const KroneckerOperator &A)
 {
-    if (A.cols() != coefficients.rows() || A.cols() != knotaverages.rows())
+    if (A.cols() != coefficients.rows())
         throw Exception("BSpline::updateControlPoints: Incompatible size of linear transformation matrix.");
-    coefficients = A*coefficients;
-    knotaverages = A*knotaverages;
+
+    if (A.rows() != (int)basis.getNumBasisFunctions())
+        throw Exception("BSpline::updateControlPoints: The linear transformation does not map to the basis functions of the B-spline.");
+
+    coefficients = A*DenseMatrix(coefficients);
+    knotaverages = computeKnotAverages();
 }
 
 void BSpline::checkControlPoints() const
 {
-    if (coefficients.rows() != knotaverages.rows())
-        throw Exception("BSpline::checkControlPoints: Inconsistent size of coefficients and knot averages matrices.");
-    if (knotaverages.cols() != numVariables)
-        throw Exception("BSpline::checkControlPoints: Inconsistent size of knot averages matrix.");
+    if (knotaverages.size() != numVariables)
+        throw Exception("BSpline::checkControlPoints: Inconsistent number of knot average vectors.");
+
+    int numControlPoints = 1;
+    for (const auto &mu : knotaverages)
+        numControlPoints *= mu.size();
+
+    if (coefficients.rows() != numControlPoints)
+        throw Exception("BSpline::checkControlPoints: Inconsistent size of coefficients and knot averages.");
 }
 
 bool BSpline::pointInDomain(DenseVector x) const
@@ -266,7 +472,7 @@ void BSpline::reduceSupport(std::vector<double> lb, std::vector<double> ub, bool
 void BSpline::globalKnotRefinement()
 {
     // Compute knot insertion matrix
-    SparseMatrix A = basis.refineKnots();
+    KroneckerOperator A = basis.refineKnots();
 
     // Update control points
     updateControlPoints(A);
@@ -275,7 +481,7 @@ void BSpline::globalKnotRefinement()
 void BSpline::localKnotRefinement(DenseVector x)
 {
     // Compute knot insertion matrix
-    SparseMatrix A = basis.refineKnotsLocally(x);
+    KroneckerOperator A = basis.refineKnotsLocally(x);
 
     // Update control points
     updateControlPoints(A);
@@ -284,56 +490,59 @@ void BSpline::localKnotRefinement(DenseVector x)
 void BSpline::decomposeToBezierForm()
 {
     // Compute knot insertion matrix
-    SparseMatrix A = basis.decomposeToBezierForm();
+    KroneckerOperator A = basis.decomposeToBezierForm();
 
     // Update control points
     updateControlPoints(A);
 }
 
-// Computes knot averages: assumes that basis is initialized!
-DenseMatrix BSpline::computeKnotAverages() const
+// Computes the knot averages of each variable: assumes that basis is initialized!
+std::vector<DenseVector> BSpline::computeKnotAverages() const
 {
-    // Calculate knot averages for each knot vector
     std::vector<DenseVector> mu_vectors;
     for (unsigned int i = 0; i < numVariables; i++)
     {
         std::vector<double> knots = basis.getKnotVector(i);
+        unsigned int degree = basis.getBasisDegree(i);
         DenseVector mu = DenseVector::Zero(basis.getNumBasisFunctions(i));
 
         for (unsigned int j = 0; j < basis.getNumBasisFunctions(i); j++)
         {
+            // The constant basis functions are located at the midpoints of their knot intervals
+            if (degree == 0)
+            {
+                mu(j) = (knots.at(j) + knots.at(j+1))/2;
+                continue;
+            }
+
             double knotAvg = 0;
-            for (unsigned int k = j+1; k <= j+basis.getBasisDegree(i); k++)
+            for (unsigned int k = j+1; k <= j+degree; k++)
             {
                 knotAvg += knots.at(k);
             }
-            mu(j) = knotAvg/basis.getBasisDegree(i);
+            mu(j) = knotAvg/degree;
         }
         mu_vectors.push_back(mu);
     }
 
-    // Calculate vectors of ones (with same length as corresponding knot average vector)
-    std::vector<DenseVector> knotOnes;
-    for (unsigned int i = 0; i < numVariables; i++)
-        knotOnes.push_back(DenseVector::Ones(mu_vectors.at(i).rows()));
+    return mu_vectors;
+}
 
-    // Fill knot average matrix one column at the time
-    DenseMatrix knot_averages = DenseMatrix::Zero(basis.getNumBasisFunctions(), numVariables);
+// Forms the numBasisFunctions x numVariables matrix of knot averages (the x-coordinates of the control points)
+DenseMatrix BSpline::expandKnotAverages() const
+{
+    DenseMatrix knot_averages(coefficients.size(), numVariables);
 
+    // Basis function k has the index (k/stride) % n in variable i, where stride is the product of n over the later variables
+    int stride = coefficients.size();
     for (unsigned int i = 0; i < numVariables; i++)
     {
-        DenseMatrix mu_ext(1,1); mu_ext(0,0) = 1;
-        for (unsigned int j = 0; j < numVariables; j++)
-        {
-            DenseMatrix temp = mu_ext;
-            if (i == j)
-                mu_ext = Eigen::kroneckerProduct(temp, mu_vectors.at(j));
-            else
-                mu_ext = Eigen::kroneckerProduct(temp, knotOnes.at(j));
-        }
-        if (mu_ext.rows() != basis.getNumBasisFunctions())
-            throw Exception("BSpline::computeKnotAverages: Incompatible size of knot average matrix.");
-        knot_averages.block(0, i, basis.getNumBasisFunctions(), 1) = mu_ext;
+        const DenseVector &mu = knotaverages.at(i);
+        int n = mu.size();
+
+        stride /= n;
+        for (int k = 0; k < knot_averages.rows(); k++)
+            knot_averages(k, i) = mu((k/stride) % n);
     }
 
     return knot_averages;
@@ -342,7 +551,7 @@ DenseMatrix BSpline::computeKnotAverages() const
 void BSpline::insertKnots(double tau, unsigned int dim, unsigned int multiplicity)
 {
     // Insert knots and compute knot insertion matrix
-    SparseMatrix A = basis.insertKnots(tau, dim, multiplicity);
+    KroneckerOperator A = basis.insertKnots(tau, dim, multiplicity);
 
     // Update control points
     updateControlPoints(A);
@@ -359,11 +568,6 @@ void BSpline::regularizeKnotVectors(std::vector<double> &lb, std::vector<double>
         unsigned int multiplicityTarget = basis.getBasisDegree(dim) + 1;
 
         // Inserting many knots at the time (to save number of B-spline coefficient calculations)
-        // NOTE: This method generates knot insertion matrices with more nonzero elements than
-        // the method that inserts one knot at the time. This causes the preallocation of
-        // kronecker product matrices to become too small and the speed deteriorates drastically
-        // in higher dimensions because reallocation is necessary. This can be prevented by
-        // precomputing the number of nonzeros when preallocating memory (see myKroneckerProduct).
         int numKnotsLB = multiplicityTarget - basis.getKnotMultiplicity(dim, lb.at(dim));
         if (numKnotsLB > 0)
         {
@@ -383,7 +587,7 @@ bool BSpline::removeUnsupportedBasisFunctions(std::vector<double> &lb, std::vect
     if (lb.size() != numVariables || ub.size() != numVariables)
         throw Exception("BSpline::removeUnsupportedBasisFunctions: Incompatible dimension of domain bounds.");
 
-    SparseMatrix A = basis.reduceSupport(lb, ub);
+    KroneckerOperator A = basis.reduceSupport(lb, ub);
 
     if (coefficients.size() != A.rows())
         return false;
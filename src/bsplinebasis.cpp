@@ -52,6 +52,449 @@ SparseVector BSplineBasis::eval(const DenseVector &x) const
     return kroneckerProductVectors(basisFunctionValues);
 }
 
+bool BSplineBasis::evalSupported(const double *x, double *values, unsigned int *first, int *spans) const
+{
+    for (unsigned int dim = 0; dim < numVariables; dim++)
+    {
+        if (!bases.at(dim).insideSupport(x[dim]))
+            return false;
+    }
+
+    for (unsigned int dim = 0; dim < numVariables; dim++)
+    {
+        first[dim] = bases[dim].evalSupported(x[dim], values, spans == nullptr ? nullptr : spans + dim);
+        values += bases[dim].getBasisDegree() + 1;
+    }
+
+    return true;
+}
+
+bool BSplineBasis::evalSupportedDerivative(const double *x, unsigned int r, double *values, unsigned int *first, int *spans) const
+{
+    for (unsigned int dim = 0; dim < numVariables; dim++)
+    {
+        if (!bases.at(dim).insideSupport(x[dim]))
+            return false;
+    }
+
+    for (unsigned int dim = 0; dim < numVariables; dim++)
+    {
+        first[dim] = bases[dim].evalSupportedDerivative(x[dim], r, values, spans == nullptr ? nullptr : spans + dim);
+        values += bases[dim].getBasisDegree() + 1;
+    }
+
+    return true;
+}
+
+bool BSplineBasis::evalSupportedDerivatives(const double *x, unsigned int maxOrder, double *values, unsigned int *first) const
+{
+    for (unsigned int dim = 0; dim < numVariables; dim++)
+    {
+        if (!bases.at(dim).insideSupport(x[dim]))
+            return false;
+    }
+
+    for (unsigned int dim = 0; dim < numVariables; dim++)
+    {
+        first[dim] = bases[dim].evalSupportedDerivatives(x[dim], maxOrder, values);
+        values += (maxOrder + 1)*(bases[dim].getBasisDegree() + 1);
+    }
+
+    return true;
+}
+
+void BSplineBasis::evalSupportedBatch(const double *X, size_t n, double *values, unsigned int *first, unsigned int r) const
+{
+    unsigned int numSupported = getNumSupportedValues();
+
+    for (unsigned int dim = 0, offset = 0; dim < numVariables; dim++)
+    {
+        bases.at(dim).evalBatch(X + dim*n, n, values + offset, numSupported, first + dim, numVariables, r);
+        offset += bases.at(dim).getBasisDegree() + 1;
+    }
+}
+
+bool BSplineBasis::evalSupportedTensorProduct(const double *x, double *values, int *indices) const
+{
+    // Stack storage for the supported basis function values, unless the degrees are high
+    double buffer[MAX_CONTRACTION_VARIABLES*(MAX_KERNEL_DEGREE + 1)];
+    std::vector<double> heapBuffer;
+    double *univariate = buffer;
+
+    unsigned int numSupported = getNumSupportedValues();
+    if (numSupported > MAX_CONTRACTION_VARIABLES*(MAX_KERNEL_DEGREE + 1))
+    {
+        heapBuffer.resize(numSupported);
+        univariate = heapBuffer.data();
+    }
+
+    if (numVariables > MAX_CONTRACTION_VARIABLES)
+        throw Exception("BSplineBasis::evalSupportedTensorProduct: Too many variables.");
+
+    unsigned int first[MAX_CONTRACTION_VARIABLES];
+
+    if (!evalSupported(x, univariate, first))
+        return false;
+
+    /*
+     * Expand the Kronecker product one variable at a time, in place. Entry a of the product so far
+     * becomes entries a*(p+1) ... a*(p+1)+p, so the entries are processed from the last to the first.
+     */
+    values[0] = 1;
+    indices[0] = 0;
+    unsigned int size = 1;
+
+    for (unsigned int dim = 0, offset = 0; dim < numVariables; dim++)
+    {
+        unsigned int numSupportedDim = bases[dim].getBasisDegree() + 1;
+        int numBasisFunctionsDim = bases[dim].getNumBasisFunctions();
+
+        for (int a = size - 1; a >= 0; --a)
+        {
+            double value = values[a];
+            int index = indices[a]*numBasisFunctionsDim + first[dim];
+
+            for (int k = numSupportedDim - 1; k >= 0; --k)
+            {
+                values[a*numSupportedDim + k] = value*univariate[offset + k];
+                indices[a*numSupportedDim + k] = index + k;
+            }
+        }
+
+        size *= numSupportedDim;
+        offset += numSupportedDim;
+    }
+
+    return true;
+}
+
+double BSplineBasis::contract(const DenseVector &coefficients, const double * const *weights, const unsigned int *first) const
+{
+    if (coefficients.size() != getNumBasisFunctions())
+        throw Exception("BSplineBasis::contract: Incompatible size of coefficient vector.");
+
+    if (numVariables > MAX_CONTRACTION_VARIABLES)
+        throw Exception("BSplineBasis::contract: Too many variables.");
+
+    return contract(coefficients.data(), weights, first);
+}
+
+double BSplineBasis::contractGradient(const DenseVector &coefficients, const double * const *weights,
+                                      const double * const *derivativeWeights, const unsigned int *first, double *gradient) const
+{
+    if (coefficients.size() != getNumBasisFunctions())
+        throw Exception("BSplineBasis::contractGradient: Incompatible size of coefficient vector.");
+
+    if (numVariables > MAX_CONTRACTION_VARIABLES)
+        throw Exception("BSplineBasis::contractGradient: Too many variables.");
+
+    return contractGradient(coefficients.data(), weights, derivativeWeights, first, gradient);
+}
+
+double BSplineBasis::evalContracted(const DenseVector &coefficients, const double *x) const
+{
+    // Stack storage for the supported basis function values, unless the degrees are high
+    double buffer[MAX_CONTRACTION_VARIABLES*(MAX_KERNEL_DEGREE + 1)];
+    std::vector<double> heapBuffer;
+    double *values = buffer;
+
+    unsigned int numSupported = getNumSupportedValues();
+    if (numSupported > MAX_CONTRACTION_VARIABLES*(MAX_KERNEL_DEGREE + 1))
+    {
+        heapBuffer.resize(numSupported);
+        values = heapBuffer.data();
+    }
+
+    if (numVariables > MAX_CONTRACTION_VARIABLES)
+        throw Exception("BSplineBasis::evalContracted: Too many variables.");
+
+    unsigned int first[MAX_CONTRACTION_VARIABLES];
+    const double *weights[MAX_CONTRACTION_VARIABLES];
+
+    if (!evalSupported(x, values, first))
+        return 0;
+
+    for (unsigned int dim = 0, offset = 0; dim < numVariables; dim++)
+    {
+        weights[dim] = values + offset;
+        offset += bases[dim].getBasisDegree() + 1;
+    }
+
+    return contract(coefficients, weights, first);
+}
+
+double BSplineBasis::evalGradientContracted(const DenseVector &coefficients, const double *x, double *gradient) const
+{
+    return evalAllContracted(coefficients, x, 1, gradient, nullptr);
+}
+
+void BSplineBasis::evalHessianContracted(const DenseVector &coefficients, const double *x, double *hessian) const
+{
+    if (coefficients.size() != getNumBasisFunctions())
+        throw Exception("BSplineBasis::evalHessianContracted: Incompatible size of coefficient vector.");
+
+    // Stack storage for the supported basis function values and derivatives, unless the degrees are high
+    double buffer[3*MAX_CONTRACTION_VARIABLES*(MAX_KERNEL_DEGREE + 1)];
+    std::vector<double> heapBuffer;
+    double *values = buffer;
+
+    unsigned int numSupported = getNumSupportedValues();
+    if (numSupported > MAX_CONTRACTION_VARIABLES*(MAX_KERNEL_DEGREE + 1))
+    {
+        heapBuffer.resize(3*numSupported);
+        values = heapBuffer.data();
+    }
+
+    if (numVariables > MAX_CONTRACTION_VARIABLES)
+        throw Exception("BSplineBasis::evalHessianContracted: Too many variables.");
+
+    unsigned int first[MAX_CONTRACTION_VARIABLES];
+
+    if (!evalSupportedDerivatives(x, 2, values, first))
+    {
+        std::fill(hessian, hessian + numVariables*numVariables, 0.0);
+        return;
+    }
+
+    contractHessian(coefficients.data(), values, first, hessian);
+}
+
+double BSplineBasis::evalAllContracted(const DenseVector &coefficients, const double *x, unsigned int order,
+                                       double *gradient, double *hessian) const
+{
+    if (order > 2)
+        throw Exception("BSplineBasis::evalAllContracted: Derivatives of order higher than 2 are not supported.");
+
+    if (coefficients.size() != getNumBasisFunctions())
+        throw Exception("BSplineBasis::evalAllContracted: Incompatible size of coefficient vector.");
+
+    if (order == 0)
+        return evalContracted(coefficients, x);
+
+    // Stack storage for the supported basis function values and derivatives, unless the degrees are high
+    double buffer[3*MAX_CONTRACTION_VARIABLES*(MAX_KERNEL_DEGREE + 1)];
+    std::vector<double> heapBuffer;
+    double *values = buffer;
+
+    unsigned int numSupported = getNumSupportedValues();
+    if (numSupported > MAX_CONTRACTION_VARIABLES*(MAX_KERNEL_DEGREE + 1))
+    {
+        heapBuffer.resize((order + 1)*numSupported);
+        values = heapBuffer.data();
+    }
+
+    if (numVariables > MAX_CONTRACTION_VARIABLES)
+        throw Exception("BSplineBasis::evalAllContracted: Too many variables.");
+
+    unsigned int first[MAX_CONTRACTION_VARIABLES];
+    const double *weights[MAX_CONTRACTION_VARIABLES];
+    const double *derivativeWeights[MAX_CONTRACTION_VARIABLES];
+
+    // Derivatives of order 0 to order of all variables in one pass
+    if (!evalSupportedDerivatives(x, order, values, first))
+    {
+        std::fill(gradient, gradient + numVariables, 0.0);
+        if (order > 1)
+            std::fill(hessian, hessian + numVariables*numVariables, 0.0);
+        return 0;
+    }
+
+    for (unsigned int dim = 0, offset = 0; dim < numVariables; dim++)
+    {
+        unsigned int numSupportedDim = bases[dim].getBasisDegree() + 1;
+        weights[dim] = values + offset;
+        derivativeWeights[dim] = values + offset + numSupportedDim;
+        offset += (order + 1)*numSupportedDim;
+    }
+
+    double value = contractGradient(coefficients.data(), weights, derivativeWeights, first, gradient);
+
+    if (order > 1)
+        contractHessian(coefficients.data(), values, first, hessian);
+
+    return value;
+}
+
+/*
+ * Iterates over the supported basis functions of all but the last variable with an odometer,
+ * where the first variable varies slowest, in accordance with the ordering of the Kronecker product used in eval.
+ * For each position, the coefficients of the last variable are contiguous and are summed with its weights.
+ * The partial sum of a variable is passed on to the preceding variable when its index wraps around.
+ */
+double BSplineBasis::contract(const double *coefficients, const double * const *weights, const unsigned int *first) const
+{
+    const int last = numVariables - 1;
+
+    unsigned int stride[MAX_CONTRACTION_VARIABLES];
+    unsigned int numSupported[MAX_CONTRACTION_VARIABLES];
+    unsigned int index[MAX_CONTRACTION_VARIABLES];
+    double partialSum[MAX_CONTRACTION_VARIABLES];
+
+    // Flattened index of the first supported coefficient
+    unsigned int offset = 0;
+    unsigned int s = 1;
+
+    for (int dim = last; dim >= 0; --dim)
+    {
+        stride[dim] = s;
+        numSupported[dim] = bases[dim].getBasisDegree() + 1;
+        index[dim] = 0;
+        partialSum[dim] = 0;
+
+        offset += first[dim]*s;
+        s *= bases[dim].getNumBasisFunctions();
+    }
+
+    const double *lastWeights = weights[last];
+    const unsigned int lastNumSupported = numSupported[last];
+
+    while (true)
+    {
+        const double *c = coefficients + offset;
+
+        double value = 0;
+        for (unsigned int k = 0; k < lastNumSupported; ++k)
+            value += lastWeights[k]*c[k];
+
+        int dim = last - 1;
+        for (; dim >= 0; --dim)
+        {
+            partialSum[dim] += weights[dim][index[dim]]*value;
+            offset += stride[dim];
+
+            if (++index[dim] < numSupported[dim])
+                break;
+
+            // Variable dim is summed out
+            offset -= numSupported[dim]*stride[dim];
+            index[dim] = 0;
+            value = partialSum[dim];
+            partialSum[dim] = 0;
+        }
+
+        if (dim < 0)
+            return value;
+    }
+}
+
+/*
+ * As contract, but each partial sum is a vector of numVariables+1 sums: element 0 is the value and element j+1 is
+ * the partial derivative with respect to variable j. When variable dim is summed out, only element dim+1 uses
+ * the derivative weights, and elements 1, ..., dim are still equal to element 0, so they are not stored.
+ */
+double BSplineBasis::contractGradient(const double *coefficients, const double * const *weights,
+                                      const double * const *derivativeWeights, const unsigned int *first, double *gradient) const
+{
+    const int last = numVariables - 1;
+
+    unsigned int stride[MAX_CONTRACTION_VARIABLES];
+    unsigned int numSupported[MAX_CONTRACTION_VARIABLES];
+    unsigned int index[MAX_CONTRACTION_VARIABLES];
+    double partialSum[MAX_CONTRACTION_VARIABLES][MAX_CONTRACTION_VARIABLES + 1];
+    double value[MAX_CONTRACTION_VARIABLES + 1];
+
+    // Flattened index of the first supported coefficient
+    unsigned int offset = 0;
+    unsigned int s = 1;
+
+    for (int dim = last; dim >= 0; --dim)
+    {
+        stride[dim] = s;
+        numSupported[dim] = bases[dim].getBasisDegree() + 1;
+        index[dim] = 0;
+        std::fill(partialSum[dim], partialSum[dim] + numVariables + 1, 0.0);
+
+        offset += first[dim]*s;
+        s *= bases[dim].getNumBasisFunctions();
+    }
+
+    const double *lastWeights = weights[last];
+    const double *lastDerivativeWeights = derivativeWeights[last];
+    const unsigned int lastNumSupported = numSupported[last];
+
+    while (true)
+    {
+        const double *c = coefficients + offset;
+
+        double v = 0, dv = 0;
+        for (unsigned int k = 0; k < lastNumSupported; ++k)
+        {
+            v += lastWeights[k]*c[k];
+            dv += lastDerivativeWeights[k]*c[k];
+        }
+        value[0] = v;
+        value[last + 1] = dv;
+
+        int dim = last - 1;
+        for (; dim >= 0; --dim)
+        {
+            double w = weights[dim][index[dim]];
+            double *sum = partialSum[dim];
+
+            sum[0] += w*value[0];
+            sum[dim + 1] += derivativeWeights[dim][index[dim]]*value[0];
+            for (unsigned int q = dim + 2; q <= numVariables; ++q)
+                sum[q] += w*value[q];
+
+            offset += stride[dim];
+
+            if (++index[dim] < numSupported[dim])
+                break;
+
+            // Variable dim is summed out
+            offset -= numSupported[dim]*stride[dim];
+            index[dim] = 0;
+
+            value[0] = sum[0];
+            sum[0] = 0;
+            for (unsigned int q = dim + 1; q <= numVariables; ++q)
+            {
+                value[q] = sum[q];
+                sum[q] = 0;
+            }
+        }
+
+        if (dim < 0)
+        {
+            for (unsigned int j = 0; j < numVariables; ++j)
+                gradient[j] = value[j + 1];
+            return value[0];
+        }
+    }
+}
+
+void BSplineBasis::contractHessian(const double *coefficients, const double *values, const unsigned int *first, double *hessian) const
+{
+    // Weights of order 0, 1 and 2 of each variable
+    const double *orderWeights[3][MAX_CONTRACTION_VARIABLES];
+    const double *weights[MAX_CONTRACTION_VARIABLES];
+
+    for (unsigned int dim = 0, offset = 0; dim < numVariables; dim++)
+    {
+        unsigned int numSupportedDim = bases[dim].getBasisDegree() + 1;
+        for (unsigned int r = 0; r <= 2; r++)
+            orderWeights[r][dim] = values + offset + r*numSupportedDim;
+        offset += 3*numSupportedDim;
+    }
+
+    // Hij = c^T (B1 x ... x DBi x ... x DBj x ... x Bn), and Hii uses DDBi
+    for (unsigned int i = 0; i < numVariables; i++)
+    {
+        for (unsigned int j = 0; j <= i; j++)
+        {
+            for (unsigned int dim = 0; dim < numVariables; dim++)
+            {
+                unsigned int r = (dim == i) + (dim == j);
+                weights[dim] = orderWeights[r][dim];
+            }
+
+            double h = contract(coefficients, weights, first);
+            hessian[j*numVariables + i] = h;
+            hessian[i*numVariables + j] = h;
+        }
+    }
+}
+
 // Old implementation of Jacobian
 DenseMatrix BSplineBasis::evalBasisJacobianOld(DenseVector &x) const
 {
@@ -88,12 +531,20 @@ DenseMatrix BSplineBasis::evalBasisJacobianOld(DenseVector &x) const
     return J;
 }
 
-// NOTE: does not pass tests
 SparseMatrix BSplineBasis::evalBasisJacobian(DenseVector &x) const
 {
     // Jacobian basis matrix
     SparseMatrix J(getNumBasisFunctions(), numVariables);
-    //J.setZero(numBasisFunctions(), numInputs);
+
+    // Evaluate basis functions and their derivatives once, before looping
+    std::vector<SparseVector> funcValues(numVariables);
+    std::vector<SparseVector> gradValues(numVariables);
+
+    for (unsigned int i = 0; i < numVariables; ++i)
+    {
+        funcValues[i] = bases.at(i).eval(x(i));
+        gradValues[i] = bases.at(i).evalDerivative(x(i), 1);
+    }
 
     // Calculate partial derivatives
     for (unsigned int i = 0; i < numVariables; ++i)
@@ -104,27 +555,19 @@ SparseMatrix BSplineBasis::evalBasisJacobian(DenseVector &x) const
         for (unsigned int j = 0; j < numVariables; ++j)
         {
             if (j == i)
-            {
-                // Differentiated basis
-                values.at(j) = bases.at(j).evalDerivative(x(j), 1);
-            }
+                values.at(j) = gradValues.at(j); // Differentiated basis
             else
-            {
-                // Normal basis
-                values.at(j) = bases.at(j).eval(x(j));
-            }
+                values.at(j) = funcValues.at(j); // Normal basis
         }
 
         SparseVector Ji = kroneckerProductVectors(values);
 
         // Fill out column
-        for (int k = 0; k < Ji.outerSize(); ++k)
-        for (SparseMatrix::InnerIterator it(Ji,k); it; ++it)
+        for (SparseVector::InnerIterator it(Ji); it; ++it)
         {
             if (it.value() != 0)
-                J.insert(it.row(),i) = it.value();
+                J.insert(it.row(), i) = it.value();
         }
-        //J.block(0,i,Ji.rows(),1) = bi.block(0,0,Ji.rows(),1);
     }
 
     J.makeCompressed();
@@ -235,16 +678,13 @@ SparseMatrix BSplineBasis::evalBasisHessian(DenseVector &x) const
     return H;
 }
 
-SparseMatrix BSplineBasis::insertKnots(double tau, unsigned int dim, unsigned int multiplicity)
+KroneckerOperator BSplineBasis::insertKnots(double tau, unsigned int dim, unsigned int multiplicity)
 {
-    SparseMatrix A(1,1);
-//    A.resize(1,1);
-    A.insert(0,0) = 1;
+    std::vector<SparseMatrix> factors;
 
     // Calculate multivariate knot insertion matrix
     for (unsigned int i = 0; i < numVariables; i++)
     {
-        SparseMatrix temp = A;
         SparseMatrix Ai;
 
         if (i == dim)
@@ -260,94 +700,53 @@ SparseMatrix BSplineBasis::insertKnots(double tau, unsigned int dim, unsigned in
             Ai.setIdentity();
         }
 
-        //A = kroneckerProduct(temp, Ai);
-        A = myKroneckerProduct(temp, Ai);
+        factors.push_back(Ai);
     }
 
-    A.makeCompressed();
-
-    return A;
+    return KroneckerOperator(factors);
 }
 
-SparseMatrix BSplineBasis::refineKnots()
+KroneckerOperator BSplineBasis::refineKnots()
 {
-    SparseMatrix A(1,1);
-    A.insert(0,0) = 1;
+    std::vector<SparseMatrix> factors;
 
     for (unsigned int i = 0; i < numVariables; i++)
-    {
-        SparseMatrix temp = A;
-        SparseMatrix Ai = bases.at(i).refineKnots();
-
-        //A = kroneckerProduct(temp, Ai);
-        A = myKroneckerProduct(temp, Ai);
-    }
+        factors.push_back(bases.at(i).refineKnots());
 
-    A.makeCompressed();
-
-    return A;
+    return KroneckerOperator(factors);
 }
 
-SparseMatrix BSplineBasis::refineKnotsLocally(DenseVector x)
+KroneckerOperator BSplineBasis::refineKnotsLocally(DenseVector x)
 {
-    SparseMatrix A(1,1);
-    A.insert(0,0) = 1;
+    std::vector<SparseMatrix> factors;
 
     for (unsigned int i = 0; i < numVariables; i++)
-    {
-        SparseMatrix temp = A;
-        SparseMatrix Ai = bases.at(i).refineKnotsLocally(x(i));
-
-        //A = kroneckerProduct(temp, Ai);
-        A = myKroneckerProduct(temp, Ai);
-    }
+        factors.push_back(bases.at(i).refineKnotsLocally(x(i)));
 
-    A.makeCompressed();
-
-    return A;
+    return KroneckerOperator(factors);
 }
 
-SparseMatrix BSplineBasis::decomposeToBezierForm()
+KroneckerOperator BSplineBasis::decomposeToBezierForm()
 {
-    SparseMatrix A(1,1);
-    A.insert(0,0) = 1;
+    std::vector<SparseMatrix> factors;
 
     for (unsigned int i = 0; i < numVariables; i++)
-    {
-        SparseMatrix temp = A;
-        SparseMatrix Ai = bases.at(i).decomposeToBezierForm();
+        factors.push_back(bases.at(i).decomposeToBezierForm());
 
-        //A = kroneckerProduct(temp, Ai);
-        A = myKroneckerProduct(temp, Ai);
-    }
-
-    A.makeCompressed();
-
-    return A;
+    return KroneckerOperator(factors);
 }
 
-SparseMatrix BSplineBasis::reduceSupport(std::vector<double>& lb, std::vector<double>& ub)
+KroneckerOperator BSplineBasis::reduceSupport(std::vector<double>& lb, std::vector<double>& ub)
 {
     if (lb.size() != ub.size() || lb.size() != numVariables)
         throw Exception("BSplineBasis::reduceSupport: Incompatible dimension of domain bounds.");
 
-    SparseMatrix A(1,1);
-    A.insert(0,0) = 1;
+    std::vector<SparseMatrix> factors;
 
     for (unsigned int i = 0; i < numVariables; i++)
-    {
-        SparseMatrix temp = A;
-        SparseMatrix Ai;
-
-        Ai = bases.at(i).reduceSupport(lb.at(i), ub.at(i));
-
-        //A = kroneckerProduct(temp, Ai);
-        A = myKroneckerProduct(temp, Ai);
-    }
+        factors.push_back(bases.at(i).reduceSupport(lb.at(i), ub.at(i)));
 
-    A.makeCompressed();
-
-    return A;
+    return KroneckerOperator(factors);
 }
 
 std::vector<unsigned int> BSplineBasis::getBasisDegrees() const
@@ -378,7 +777,7 @@ unsigned int BSplineBasis::getNumBasisFunctions() const
     return prod;
 }
 
-BSplineBasis1D BSplineBasis::getSingleBasis(int dim)
+BSplineBasis1D BSplineBasis::getSingleBasis(int dim) const
 {
     return bases.at(dim);
 }
@@ -431,6 +830,16 @@ int BSplineBasis::supportedPrInterval() const
     return ret;
 }
 
+unsigned int BSplineBasis::getNumSupportedValues() const
+{
+    unsigned int sum = 0;
+    for (unsigned int dim = 0; dim < numVariables; dim++)
+    {
+        sum += bases.at(dim).getBasisDegree() + 1;
+    }
+    return sum;
+}
+
 bool BSplineBasis::insideSupport(DenseVector &x) const
 {
     for (unsigned int dim = 0; dim < numVariables; dim++)
@@ -8,6 +8,7 @@
 */
 
 #include <bsplinebasis1d.h>
+#include <bsplinebasisbatch.h>
 #include <knots.h>
 #include <algorithm>
 #include <utilities.h>
@@ -17,13 +18,16 @@ namespace SPLINTER
 {
 
 BSplineBasis1D::BSplineBasis1D()
+    : kernel(nullptr)
 {
 }
 
 BSplineBasis1D::BSplineBasis1D(const std::vector<double> &knots, unsigned int degree)
     : degree(degree),
       knots(knots),
-      targetNumBasisfunctions((degree+1)+2*degree+1) // Minimum p+1
+      targetNumBasisfunctions((degree+1)+2*degree+1), // Minimum p+1
+      locator(knots),
+      kernel(getBasisKernel(degree))
 {
 //    if (degree <= 0)
 //        throw Exception("BSplineBasis1D::BSplineBasis1D: Cannot create B-spline basis functions of degree <= 0.");
@@ -39,34 +43,21 @@ SparseVector BSplineBasis1D::eval(double x) const
     if (!insideSupport(x))
         return values;
 
-    supportHack(x);
+    double buffer[MAX_KERNEL_DEGREE + 1];
+    std::vector<double> heapBuffer;
+    double *basisValues = valueBuffer(buffer, heapBuffer);
 
-    std::vector<int> indexSupported = indexSupportedBasisfunctions(x);
+    unsigned int first = evalSupported(x, basisValues);
 
-    values.reserve(indexSupported.size());
+    values.reserve(degree + 1);
 
-    // Evaluate nonzero basis functions
-    for (auto it = indexSupported.begin(); it != indexSupported.end(); ++it)
+    // Store nonzero basis functions
+    for (unsigned int k = 0; k <= degree; ++k)
     {
-        double val = deBoorCox(x, *it, degree);
-        if (fabs(val) > 1e-12)
-            values.insert(*it) = val;
+        if (fabs(basisValues[k]) > 1e-12)
+            values.insert(first + k) = basisValues[k];
     }
 
-    // Alternative evaluation using basis matrix
-//    int knotIndex = indexHalfopenInterval(x); // knot index
-
-//    SparseMatrix basisvalues2 = buildBsplineMatrix(x, knotIndex, 1);
-//    for (int i = 2; i <= basisDegree; i++)
-//    {
-//        SparseMatrix Ri = buildBsplineMatrix(x, knotIndex, i);
-//        basisvalues2 = basisvalues2*Ri;
-//    }
-//    basisvalues2.makeCompressed();
-
-//    assert(basisvalues2.rows() == 1);
-//    assert(basisvalues2.cols() == basisDegree + 1);
-
     return values;
 }
 
@@ -75,52 +66,23 @@ SparseVector BSplineBasis1D::evalDerivative(double x, int r) const
     // Evaluate rth derivative of basis functions at x
     // Returns vector [D^(r)B_(u-p,p)(x) ... D^(r)B_(u,p)(x)]
     // where u is the knot index and p is the degree
-    int p = degree;
+    SparseVector DB(getNumBasisFunctions());
 
-    // Continuity requirement
-    //assert(p > r);
-    if (p <= r)
-    {
-        // Return zero-gradient
-        SparseVector DB(getNumBasisFunctions());
+    // The rth derivative of a polynomial of degree p < r is zero
+    if (r < 0 || (int)degree < r)
         return DB;
-    }
 
-    // Check for knot multiplicity here!
+    double buffer[MAX_KERNEL_DEGREE + 1];
+    std::vector<double> heapBuffer;
+    double *basisValues = valueBuffer(buffer, heapBuffer);
 
-    supportHack(x);
-
-    int knotIndex = indexHalfopenInterval(x);
-
-    // Algorithm 3.18 from Lyche and Moerken (2011)
-    SparseMatrix B(1,1);
-    B.insert(0,0) = 1;
-
-    for (int i = 1; i <= p-r; i++)
-    {
-        SparseMatrix R = buildBasisMatrix(x, knotIndex, i);
-        B = B*R;
-    }
+    unsigned int first = evalSupportedDerivative(x, r, basisValues);
 
-    for (int i = p-r+1; i <= p; i++)
+    DB.reserve(degree + 1);
+    for (unsigned int k = 0; k <= degree; ++k)
     {
-        SparseMatrix DR = buildBasisMatrix(x, knotIndex, i, true);
-        B = B*DR;
-    }
-    double factorial = std::tgamma(p+1)/std::tgamma(p-r+1);
-    B = B*factorial;
-
-    if (B.cols() != p+1)
-        throw Exception("BSplineBasis1D::evalDerivative: Wrong number of columns of B matrix.");
-
-    // From row vector to extended column vector
-    SparseVector DB(getNumBasisFunctions());
-    DB.reserve(p+1);
-    int i = knotIndex-p; // First insertion index
-    for (int k = 0; k < B.outerSize(); ++k)
-    for (SparseMatrix::InnerIterator it(B,k); it; ++it)
-    {
-        DB.insert(i+it.col()) = it.value();
+        if (basisValues[k] != 0)
+            DB.insert(first + k) = basisValues[k];
     }
 
     return DB;
@@ -156,63 +118,212 @@ SparseVector BSplineBasis1D::evalFirstDerivative(double x) const
     return values;
 }
 
-// Used to evaluate basis functions - alternative to the recursive deBoorCox
-SparseMatrix BSplineBasis1D::buildBasisMatrix(double x, unsigned int u, unsigned int k, bool diff) const
+unsigned int BSplineBasis1D::evalSupported(double x, double *values, int *span) const
+{
+    supportHack(x);
+
+    int u = (span == nullptr) ? indexHalfopenInterval(x) : indexHalfopenInterval(x, *span);
+    if (span != nullptr)
+        *span = u;
+    deBoorKernel(x, u, 0, values);
+
+    return shiftToSupported(u, values);
+}
+
+unsigned int BSplineBasis1D::evalSupportedDerivative(double x, unsigned int r, double *values, int *span) const
 {
-    /* Build B-spline Matrix
-     * R_k in R^(k,k+1)
-     * or, if diff = true, the differentiated basis matrix
-     * DR_k in R^(k,k+1)
-     */
+    supportHack(x);
 
-    if (!(k >= 1 && k <= getBasisDegree()))
+    int u = (span == nullptr) ? indexHalfopenInterval(x) : indexHalfopenInterval(x, *span);
+    if (span != nullptr)
+        *span = u;
+
+    if (degree < r)
     {
-        throw Exception("BSplineBasis1D::buildBasisMatrix: Incorrect input paramaters!");
+        std::fill(values, values + degree + 1, 0.0);
+        return indexFirstSupported(u);
     }
 
-//    assert(u >= basisDegree + 1);
-//    assert(u < ks.size() - basisDegree);
+    deBoorKernel(x, u, r, values);
+
+    return shiftToSupported(u, values);
+}
+
+unsigned int BSplineBasis1D::evalSupportedDerivatives(double x, unsigned int maxOrder, double *values, int *span) const
+{
+    supportHack(x);
+
+    int u = (span == nullptr) ? indexHalfopenInterval(x) : indexHalfopenInterval(x, *span);
+    if (span != nullptr)
+        *span = u;
 
-    unsigned int rows = k;
-    unsigned int cols = k+1;
-    SparseMatrix R(rows, cols);
-    R.reserve(Eigen::VectorXi::Constant(cols, 2));
+    unsigned int first = indexFirstSupported(u);
 
-    for (unsigned int i = 0; i < rows; i++)
+    for (unsigned int r = 0; r <= maxOrder; ++r)
     {
-        double dk = knots.at(u+1+i) - knots.at(u+1+i-k);
-        if (dk == 0)
+        double *orderValues = values + r*(degree + 1);
+
+        if (degree < r)
         {
+            std::fill(orderValues, orderValues + degree + 1, 0.0);
             continue;
         }
-        else
+
+        deBoorKernel(x, u, r, orderValues);
+        shiftToSupported(u, orderValues);
+    }
+
+    return first;
+}
+
+void BSplineBasis1D::evalBatch(const double *x, size_t n, double *values, unsigned int *first, unsigned int r) const
+{
+    evalBatch(x, n, values, degree + 1, first, 1, r);
+}
+
+void BSplineBasis1D::evalBatch(const double *x, size_t n, double *values, size_t valueStride,
+                               unsigned int *first, size_t firstStride, unsigned int r) const
+{
+    BasisBlockKernel block = getBasisBlockKernel();
+    const unsigned int L = block.lanes;
+
+    // Knot interval of the previous point, used as search hint
+    int span = -1;
+
+    size_t i = 0;
+
+    if (L > 1 && r <= degree)
+    {
+        // Knot windows, points and basis values of a block in structure-of-arrays layout
+        std::vector<double> T(2*degree*L);
+        std::vector<double> xs(L);
+        std::vector<double> N((degree + 1)*L);
+        std::vector<int> u(L);
+
+        double factorial = 1;
+        for (unsigned int k = degree - r + 1; k <= degree; ++k)
+            factorial *= k;
+
+        for (; i + L <= n; i += L)
         {
-            if (diff)
+            for (unsigned int lane = 0; lane < L; ++lane)
             {
-                // Insert diagonal element
-                R.insert(i,i) = -1/dk;
-
-                // Insert super-diagonal element
-                R.insert(i,i+1) = 1/dk;
+                double xl = x[i + lane];
+                supportHack(xl);
+
+                span = indexHalfopenInterval(xl, span);
+                u[lane] = span;
+                xs[lane] = xl;
+
+                int lo = span - (int)degree + 1;
+                if (lo >= 0 && lo + 2*degree <= knots.size())
+                {
+                    for (unsigned int m = 0; m < 2*degree; ++m)
+                        T[m*L + lane] = knots[lo + m];
+                }
+                else
+                {
+                    for (unsigned int m = 0; m < 2*degree; ++m)
+                        T[m*L + lane] = knotClamped(knots.data(), knots.size(), lo + m);
+                }
             }
-            else
+
+            block.function(T.data(), xs.data(), degree, r, N.data());
+
+            for (unsigned int lane = 0; lane < L; ++lane)
             {
-                // Insert diagonal element
-                double a = (knots.at(u+1+i) - x)/dk;
-                if (a != 0)
-                    R.insert(i,i) = a;
-
-                // Insert super-diagonal element
-                double b = (x - knots.at(u+1+i-k))/dk;
-                if (b != 0)
-                    R.insert(i,i+1) = b;
+                double *out = values + (i + lane)*valueStride;
+                for (unsigned int k = 0; k <= degree; ++k)
+                    out[k] = factorial*N[k*L + lane];
+
+                // Only the ends of knot vectors that are not clamped require a shift
+                unsigned int firstSupported = u[lane] - degree;
+                if (u[lane] < (int)degree || firstSupported + degree >= getNumBasisFunctions())
+                    firstSupported = shiftToSupported(u[lane], out);
+
+                first[(i + lane)*firstStride] = firstSupported;
             }
         }
     }
 
-    R.makeCompressed();
+    // Remaining points
+    for (; i < n; ++i)
+        first[i*firstStride] = evalSupportedDerivative(x[i], r, values + i*valueStride, &span);
+}
+
+void BSplineBasis1D::deBoorKernel(double x, int u, unsigned int r, double *values) const
+{
+    if (kernel != nullptr)
+    {
+        kernel(knots.data(), knots.size(), x, u, r, values);
+        return;
+    }
+
+    values[0] = 1;
+
+    for (unsigned int k = 1; k <= degree; ++k)
+        applyBasisMatrix(knots.data(), knots.size(), x, u, k, k + r > degree, values);
+
+    // Scale derivatives by p!/(p-r)!
+    if (r > 0)
+    {
+        double factorial = 1;
+        for (unsigned int k = degree - r + 1; k <= degree; ++k)
+            factorial *= k;
+
+        for (unsigned int k = 0; k <= degree; ++k)
+            values[k] *= factorial;
+    }
+}
+
+/*
+ * Returns the stack buffer if it can hold the degree+1 basis function values,
+ * otherwise the heap buffer is sized to hold them.
+ */
+double *BSplineBasis1D::valueBuffer(double *buffer, std::vector<double> &heapBuffer) const
+{
+    if (degree <= MAX_KERNEL_DEGREE)
+        return buffer;
+
+    heapBuffer.resize(degree + 1);
+    return heapBuffer.data();
+}
+
+/*
+ * Clamps the window of supported basis functions to the existing basis functions.
+ * For knot vectors that are not clamped, the window is shifted at the ends of the support and
+ * the basis functions that are not supported at x simply evaluate to zero.
+ */
+unsigned int BSplineBasis1D::indexFirstSupported(int u) const
+{
+    int first = u - (int)degree;
+    int last = (int)getNumBasisFunctions() - (int)degree - 1;
+    return (unsigned int)std::max(0, std::min(first, last));
+}
+
+/*
+ * The kernel computes the values of B_(u-p,p) ... B_(u,p). At the ends of a knot vector that is not
+ * clamped, some of these basis functions do not exist (their values are computed from clamped knot values
+ * and never affect the existing basis functions). They are replaced by the zero-valued basis functions
+ * at the other end of the window.
+ */
+unsigned int BSplineBasis1D::shiftToSupported(int u, double *values) const
+{
+    unsigned int first = indexFirstSupported(u);
+    int shift = (int)first - (u - (int)degree);
 
-    return R;
+    if (shift > 0)
+    {
+        for (int k = 0; k <= (int)degree; ++k)
+            values[k] = (k + shift <= (int)degree) ? values[k + shift] : 0;
+    }
+    else if (shift < 0)
+    {
+        for (int k = degree; k >= 0; --k)
+            values[k] = (k + shift >= 0) ? values[k + shift] : 0;
+    }
+
+    return first;
 }
 
 double BSplineBasis1D::deBoorCox(double x, int i, int k) const
@@ -268,7 +379,7 @@ SparseMatrix BSplineBasis1D::insertKnots(double tau, unsigned int multiplicity)
     SparseMatrix A = buildKnotInsertionMatrix(extKnots);
 
     // Update knots
-    knots = extKnots;
+    setKnots(extKnots);
 
     return A;
 }
@@ -296,7 +407,7 @@ SparseMatrix BSplineBasis1D::refineKnots()
     SparseMatrix A = buildKnotInsertionMatrix(refinedKnots);
 
     // Update knots
-    knots = refinedKnots;
+    setKnots(refinedKnots);
 
     return A;
 }
@@ -358,7 +469,7 @@ SparseMatrix BSplineBasis1D::refineKnotsLocally(double x)
     SparseMatrix A = buildKnotInsertionMatrix(refinedKnots);
 
     // Update knots
-    knots = refinedKnots;
+    setKnots(refinedKnots);
 
     return A;
 }
@@ -394,7 +505,7 @@ SparseMatrix BSplineBasis1D::decomposeToBezierForm()
     SparseMatrix A = buildKnotInsertionMatrix(refinedKnots);
 
     // Update knots
-    knots = refinedKnots;
+    setKnots(refinedKnots);
 
     return A;
 }
@@ -415,33 +526,24 @@ SparseMatrix BSplineBasis1D::buildKnotInsertionMatrix(const std::vector<double>
     //A.resize(m,n);
     A.reserve(Eigen::VectorXi::Constant(n, degree + 1));
 
+    std::vector<double> values(degree + 1);
+
     // Build A row-by-row
     for (unsigned int i = 0; i < m; i++)
     {
         int u = indexHalfopenInterval(knotsAug.at(i));
 
-        SparseMatrix R(1,1);
-        R.insert(0,0) = 1;
-
-        // For p > 0
+        // Apply R_1 ... R_p with the knots of the refined knot vector as evaluation points
+        values[0] = 1;
         for (unsigned int j = 1; j <= degree; j++)
-        {
-            SparseMatrix Ri = buildBasisMatrix(knotsAug.at(i + j), u, j);
-            R = R*Ri;
-        }
-
-        // Size check
-        if (R.rows() != 1 || R.cols() != (int)degree + 1)
-        {
-            throw Exception("BSplineBasis1D::buildKnotInsertionMatrix: Incorrect matrix dimensions!");
-        }
+            applyBasisMatrix(knots.data(), knots.size(), knotsAug.at(i + j), u, j, false, values.data());
 
         // Insert row values
-        int j = u - degree; // First insertion index
-        for (int k = 0; k < R.outerSize(); ++k)
-        for (SparseMatrix::InnerIterator it(R, k); it; ++it)
+        unsigned int first = shiftToSupported(u, values.data());
+        for (unsigned int k = 0; k <= degree; ++k)
         {
-            A.insert(i, j + it.col()) = it.value();
+            if (values[k] != 0)
+                A.insert(i, first + k) = values[k];
         }
     }
 
@@ -463,19 +565,29 @@ void BSplineBasis1D::supportHack(double &x) const
 
 /*
  * Finds index i such that knots.at(i) <= x < knots.at(i+1).
- * Returns false if x is outside support.
+ * Throws if x is outside support.
  */
 int BSplineBasis1D::indexHalfopenInterval(double x) const
 {
-    if (x < knots.front() || x > knots.back())
+    if (!(knots.front() <= x && x <= knots.back()))
+        throw Exception("BSplineBasis1D::indexHalfopenInterval: x outside knot interval!");
+
+    return locator.find(x);
+}
+
+// As above, starting the search from the knot interval hint (ignored if negative)
+int BSplineBasis1D::indexHalfopenInterval(double x, int hint) const
+{
+    if (!(knots.front() <= x && x <= knots.back()))
         throw Exception("BSplineBasis1D::indexHalfopenInterval: x outside knot interval!");
 
-    // Find first knot that is larger than x
-    std::vector<double>::const_iterator it = std::upper_bound(knots.begin(), knots.end(), x);
+    return locator.find(x, hint);
+}
 
-    // Return index
-    int index = it - knots.begin();
-    return index - 1;
+void BSplineBasis1D::setKnots(const std::vector<double> &newKnots)
+{
+    knots = newKnots;
+    locator = KnotIntervalLocator(knots);
 }
 
 SparseMatrix BSplineBasis1D::reduceSupport(double lb, double ub)
@@ -525,7 +637,7 @@ SparseMatrix BSplineBasis1D::reduceSupport(double lb, double ub)
     SparseMatrix A = Ad.sparseView();
 
     // Update knots
-    knots = si;
+    setKnots(si);
 
     return A;
 }
@@ -0,0 +1,140 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <bsplinebasisbatch.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define SPLINTER_X86_SIMD
+# include <immintrin.h>
+#endif
+
+namespace SPLINTER
+{
+
+#ifdef SPLINTER_X86_SIMD
+
+/*
+ * The kernels apply the basis matrices R_k (or DR_k) in place, as applyBasisMatrix does for a single point.
+ * Rows with a zero knot difference are masked out instead of skipped, so all lanes run the same instructions.
+ */
+__attribute__((target("avx2")))
+static void evalBasisBlockAVX2(const double *T, const double *x, unsigned int degree, unsigned int r, double *N)
+{
+    const unsigned int L = 4;
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d X = _mm256_loadu_pd(x);
+
+    _mm256_storeu_pd(N, one);
+
+    for (unsigned int k = 1; k <= degree; ++k)
+    {
+        bool diff = k + r > degree;
+
+        _mm256_storeu_pd(N + k*L, zero);
+
+        for (int i = k - 1; i >= 0; --i)
+        {
+            __m256d v = _mm256_loadu_pd(N + i*L);
+            __m256d tl = _mm256_loadu_pd(T + (i - k + degree)*L);
+            __m256d tr = _mm256_loadu_pd(T + (i + degree)*L);
+            __m256d dk = _mm256_sub_pd(tr, tl);
+            __m256d mask = _mm256_cmp_pd(dk, zero, _CMP_NEQ_OQ);
+
+            __m256d next = _mm256_loadu_pd(N + (i + 1)*L);
+
+            if (diff)
+            {
+                __m256d a = _mm256_and_pd(mask, _mm256_div_pd(v, dk));
+                _mm256_storeu_pd(N + i*L, _mm256_sub_pd(zero, a));
+                _mm256_storeu_pd(N + (i + 1)*L, _mm256_add_pd(next, a));
+            }
+            else
+            {
+                __m256d alpha = _mm256_and_pd(mask, _mm256_div_pd(_mm256_sub_pd(X, tl), dk));
+                __m256d m = _mm256_and_pd(mask, one);
+                _mm256_storeu_pd(N + i*L, _mm256_mul_pd(v, _mm256_sub_pd(m, alpha)));
+                _mm256_storeu_pd(N + (i + 1)*L, _mm256_add_pd(next, _mm256_mul_pd(v, alpha)));
+            }
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static void evalBasisBlockAVX512(const double *T, const double *x, unsigned int degree, unsigned int r, double *N)
+{
+    const unsigned int L = 8;
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d X = _mm512_loadu_pd(x);
+
+    _mm512_storeu_pd(N, one);
+
+    for (unsigned int k = 1; k <= degree; ++k)
+    {
+        bool diff = k + r > degree;
+
+        _mm512_storeu_pd(N + k*L, zero);
+
+        for (int i = k - 1; i >= 0; --i)
+        {
+            __m512d v = _mm512_loadu_pd(N + i*L);
+            __m512d tl = _mm512_loadu_pd(T + (i - k + degree)*L);
+            __m512d tr = _mm512_loadu_pd(T + (i + degree)*L);
+            __m512d dk = _mm512_sub_pd(tr, tl);
+            __mmask8 mask = _mm512_cmp_pd_mask(dk, zero, _CMP_NEQ_OQ);
+
+            __m512d next = _mm512_loadu_pd(N + (i + 1)*L);
+
+            if (diff)
+            {
+                __m512d a = _mm512_maskz_div_pd(mask, v, dk);
+                _mm512_storeu_pd(N + i*L, _mm512_sub_pd(zero, a));
+                _mm512_storeu_pd(N + (i + 1)*L, _mm512_add_pd(next, a));
+            }
+            else
+            {
+                __m512d alpha = _mm512_maskz_div_pd(mask, _mm512_sub_pd(X, tl), dk);
+                __m512d m = _mm512_maskz_mov_pd(mask, one);
+                _mm512_storeu_pd(N + i*L, _mm512_mul_pd(v, _mm512_sub_pd(m, alpha)));
+                _mm512_storeu_pd(N + (i + 1)*L, _mm512_add_pd(next, _mm512_mul_pd(v, alpha)));
+            }
+        }
+    }
+}
+
+static BasisBlockKernel detectBasisBlockKernel()
+{
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+        return BasisBlockKernel{8, &evalBasisBlockAVX512};
+
+    if (__builtin_cpu_supports("avx2"))
+        return BasisBlockKernel{4, &evalBasisBlockAVX2};
+
+    return BasisBlockKernel{1, nullptr};
+}
+
+BasisBlockKernel getBasisBlockKernel()
+{
+    static const BasisBlockKernel kernel = detectBasisBlockKernel();
+    return kernel;
+}
+
+#else
+
+BasisBlockKernel getBasisBlockKernel()
+{
+    return BasisBlockKernel{1, nullptr};
+}
+
+#endif // SPLINTER_X86_SIMD
+
+} // namespace SPLINTER
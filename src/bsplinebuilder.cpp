@@ -11,8 +11,12 @@
 #include "mykroneckerproduct.h"
 #include "unsupported/Eigen/KroneckerProduct"
 #include <linearsolvers.h>
+#include <iterativesolvers.h>
 #include <serializer.h>
 #include <iostream>
+#include <memory>
+#include <algorithm>
+#include <cmath>
 #include <utilities.h>
 
 namespace SPLINTER
@@ -25,6 +29,9 @@ BSpline::Builder::Builder(const DataTable &data)
         _numBasisFunctions(std::vector<unsigned int>(data.getNumVariables(), 0)),
         _knotSpacing(KnotSpacing::AS_SAMPLED),
         _smoothing(Smoothing::NONE),
+        _solver(Solver::DEFAULT),
+        _tolerance(1e-12),
+        _maxIterations(1000),
         _alpha(0.1)
 {
 }
@@ -33,27 +40,186 @@ BSpline::Builder::Builder(const DataTable &data)
  * Build B-spline
  */
 BSpline BSpline::Builder::build() const
+{
+    SolverStatistics statistics;
+    BSpline bspline = build(statistics);
+
+    if (!statistics.converged)
+        throw Exception("BSpline::Builder::build: The iterative solver did not converge.");
+
+    return bspline;
+}
+
+/*
+ * Build B-spline and report the convergence of the linear solver
+ * (an unconverged iterative solve is returned as is, with statistics.converged = false)
+ */
+BSpline BSpline::Builder::build(SolverStatistics &statistics) const
 {
     // Check data
     // TODO: Remove this test
     if (!_data.isGridComplete())
         throw Exception("BSpline::Builder::build: Cannot create B-spline from irregular (incomplete) grid.");
 
+    return plan().fit(getSamplePointValues(), statistics);
+}
+
+/*
+ * Build one B-spline per column of Y, where each row of Y holds the sample values of one sample point,
+ * in the order of the samples of the data table (sorted by x). The y-values of the data table are not used.
+ * All B-splines share the knot vectors, and the basis matrix is assembled and factorized once.
+ */
+std::vector<BSpline> BSpline::Builder::build(const DenseMatrix &Y) const
+{
+    SolverStatistics statistics;
+    std::vector<BSpline> bsplines = build(Y, statistics);
+
+    if (!statistics.converged)
+        throw Exception("BSpline::Builder::build: The iterative solver did not converge.");
+
+    return bsplines;
+}
+
+std::vector<BSpline> BSpline::Builder::build(const DenseMatrix &Y, SolverStatistics &statistics) const
+{
+    if (!_data.isGridComplete())
+        throw Exception("BSpline::Builder::build: Cannot create B-spline from irregular (incomplete) grid.");
+
+    if (Y.rows() != (int)_data.getNumSamples())
+        throw Exception("BSpline::Builder::build: Expected one row of sample values per sample.");
+
+    return plan().fit(Y, statistics);
+}
+
+BSpline::FitPlan BSpline::Builder::plan() const
+{
+    if (!_data.isGridComplete())
+        throw Exception("BSpline::Builder::plan: Cannot create B-spline from irregular (incomplete) grid.");
+
     // Build knot vectors
     auto knotVectors = computeKnotVectors();
 
     // Build B-spline (with default coefficients)
     auto bspline = BSpline(knotVectors, _degrees);
 
-    // Compute coefficients from samples and update B-spline
-    auto coefficients = computeCoefficients(bspline);
-    bspline.setCoefficients(coefficients);
+    return FitPlan(bspline, _data.getNumSamples(), prepareSolver(bspline));
+}
 
-    return bspline;
+/*
+ * Online fit: the normal equations of the samples in the data table (with the smoothing term of the builder)
+ * are stored in the sparsity pattern of all pairs of basis functions with overlapping support, so that later
+ * samples only update existing entries.
+ */
+BSpline::OnlineFit BSpline::Builder::online(double forgettingFactor) const
+{
+    if (forgettingFactor <= 0 || forgettingFactor > 1)
+        throw Exception("BSpline::Builder::online: The forgetting factor must be in (0, 1].");
+
+    auto bspline = BSpline(computeKnotVectors(), _degrees);
+
+    SparseMatrix B = computeBasisFunctionMatrix(bspline);
+    SparseMatrix Bt = B.transpose();
+    SparseMatrix A = Bt*B;
+
+    if (_smoothing == Smoothing::IDENTITY)
+    {
+        auto I = SparseMatrix(A.cols(), A.cols());
+        I.setIdentity();
+        A += _alpha*I;
+    }
+    else if (_smoothing == Smoothing::PSPLINE)
+    {
+        SparseMatrix D = getSecondOrderFiniteDifferenceMatrix(bspline);
+        A += _alpha*D.transpose()*D;
+    }
+
+    /*
+     * Basis functions i and j overlap if their indices differ by at most the degree in each variable.
+     * The overlapping pairs are added as explicit zeros (lower triangle only), variable by variable:
+     * the multi-index of basis function i is decoded with the strides of the variables (the last variable fastest).
+     */
+    unsigned int numVariables = bspline.getNumVariables();
+    int numBasisFunctions = bspline.getNumBasisFunctions();
+    std::vector<int> strides(numVariables), degrees(numVariables), sizes(numVariables);
+    for (int dim = numVariables - 1, stride = 1; dim >= 0; dim--)
+    {
+        strides.at(dim) = stride;
+        degrees.at(dim) = bspline.basis.getBasisDegree(dim);
+        sizes.at(dim) = bspline.basis.getNumBasisFunctions(dim);
+        stride *= sizes.at(dim);
+    }
+
+    std::vector<Eigen::Triplet<double>> pattern;
+    std::vector<int> offsets;
+    for (int i = 0; i < numBasisFunctions; ++i)
+    {
+        // Indices j >= i of the basis functions overlapping i
+        offsets.assign(1, i);
+        for (unsigned int dim = 0; dim < numVariables; ++dim)
+        {
+            int position = i/strides.at(dim) % sizes.at(dim);
+            std::vector<int> expanded;
+            for (int j : offsets)
+                for (int shift = -degrees.at(dim); shift <= degrees.at(dim); ++shift)
+                    if (position + shift >= 0 && position + shift < sizes.at(dim))
+                        expanded.push_back(j + shift*strides.at(dim));
+            offsets.swap(expanded);
+        }
+
+        for (int j : offsets)
+            if (j >= i)
+                pattern.push_back(Eigen::Triplet<double>(j, i, 0.0));
+    }
+
+    SparseMatrix P(numBasisFunctions, numBasisFunctions);
+    P.setFromTriplets(pattern.begin(), pattern.end());
+
+    SparseMatrix lower = A.triangularView<Eigen::Lower>();
+    SparseMatrix normal = lower + P;
+    normal.makeCompressed();
+
+    DenseVector rhs = Bt*getSamplePointValues();
+
+    OnlineFit fit(bspline, normal, rhs, _data.getNumSamples(), forgettingFactor);
+
+    // The pattern is analyzed once; fail early if the samples do not determine the coefficients
+    fit.analyzePattern();
+    fit.factorize();
+
+    return fit;
 }
 
 /*
- * Find coefficients of B-spline by solving:
+ * Solves one column at a time with a solver for a single right-hand side. The statistics of the
+ * columns are combined into the worst case (most iterations, largest residual, converged if all converged).
+ */
+static BSpline::FitPlan::CoefficientSolver solveColumnwise(std::function<DenseVector(const DenseVector &, SolverStatistics &)> solve)
+{
+    return [solve](const DenseMatrix &B, SolverStatistics &statistics) -> DenseMatrix
+    {
+        statistics = SolverStatistics();
+
+        DenseMatrix X;
+        for (int j = 0; j < B.cols(); ++j)
+        {
+            SolverStatistics columnStatistics;
+            DenseVector x = solve(B.col(j), columnStatistics);
+
+            if (j == 0)
+                X.resize(x.size(), B.cols());
+            X.col(j) = x;
+
+            statistics.iterations = std::max(statistics.iterations, columnStatistics.iterations);
+            statistics.relativeResidual = std::max(statistics.relativeResidual, columnStatistics.relativeResidual);
+            statistics.converged = statistics.converged && columnStatistics.converged;
+        }
+
+        return X;
+    };
+}
+
+/*
+ * Prepares the solver for the coefficients of the B-spline, which solves:
  * min ||A*x - b||^2 + alpha*||R||^2,
  * where
  * A = mxn matrix of n basis functions evaluated at m sample points,
@@ -62,11 +228,26 @@ BSpline BSpline::Builder::build() const
  * R = Regularization matrix,
  * alpha = regularization parameter.
  */
-DenseVector BSpline::Builder::computeCoefficients(const BSpline& bspline) const
+BSpline::FitPlan::CoefficientSolver BSpline::Builder::prepareSolver(const BSpline &bspline) const
+{
+    if (_solver == Solver::KRONECKER)
+        return prepareKroneckerSolver(bspline);
+
+    if (_solver == Solver::LSQR || _solver == Solver::CGLS || _solver == Solver::CG)
+        return prepareIterativeSolver(bspline);
+
+    return prepareDirectSolver(bspline);
+}
+
+/*
+ * Factorizes the basis matrix (NONE) or the normal equations (IDENTITY and PSPLINE) once,
+ * so that each fit is a multiplication with B' (if smoothing) followed by the triangular solves.
+ */
+BSpline::FitPlan::CoefficientSolver BSpline::Builder::prepareDirectSolver(const BSpline &bspline) const
 {
     SparseMatrix B = computeBasisFunctionMatrix(bspline);
     SparseMatrix A = B;
-    DenseVector b = getSamplePointValues();
+    SparseMatrix Bt;
 
     if (_smoothing == Smoothing::IDENTITY)
     {
@@ -79,9 +260,8 @@ DenseVector BSpline::Builder::computeCoefficients(const BSpline& bspline) const
          *
          * NOTE2: consider changing regularization factor to (alpha/numSample)
          */
-        SparseMatrix Bt = B.transpose();
+        Bt = B.transpose();
         A = Bt*B;
-        b = Bt*b;
 
         auto I = SparseMatrix(A.cols(), A.cols());
         I.setIdentity();
@@ -109,104 +289,558 @@ DenseVector BSpline::Builder::computeCoefficients(const BSpline& bspline) const
         // Assuming regular grid
         unsigned int numSamples = _data.getNumSamples();
 
-        SparseMatrix Bt = B.transpose();
-
         // Weight matrix
         SparseMatrix W;
         W.resize(numSamples, numSamples);
         W.setIdentity();
 
+        // Right-hand side matrix
+        Bt = B.transpose()*W;
+
         // Second order finite difference matrix
         SparseMatrix D = getSecondOrderFiniteDifferenceMatrix(bspline);
 
         // Left-hand side matrix
-        A = Bt*W*B + _alpha*D.transpose()*D;
-
-        // Compute right-hand side matrices
-        b = Bt*W*b;
+        A = Bt*B + _alpha*D.transpose()*D;
     }
 
-    DenseVector x;
-
     int numEquations = A.rows();
     int maxNumEquations = 100;
     bool solveAsDense = (numEquations < maxNumEquations);
 
+    std::shared_ptr<LinearFactorization<SparseMatrix>> sparseFactorization;
+    std::shared_ptr<DenseQRFactorization> denseFactorization;
+
     if (!solveAsDense)
     {
 #ifndef NDEBUG
-        std::cout << "BSpline::Builder::computeBSplineCoefficients: Computing B-spline control points using sparse solver." << std::endl;
+        std::cout << "BSpline::Builder::prepareDirectSolver: Computing B-spline control points using sparse solver." << std::endl;
 #endif // NDEBUG
 
-        SparseLU<> s;
-        //bool successfulSolve = (s.solve(A,Bx,Cx) && s.solve(A,By,Cy));
+        // Least squares solutions of rectangular systems (interpolation with fewer basis functions than samples)
+        if (A.rows() == A.cols())
+            sparseFactorization = std::make_shared<SparseLUFactorization>();
+        else
+            sparseFactorization = std::make_shared<SparseQRFactorization>();
 
-        solveAsDense = !s.solve(A, b, x);
+        A.makeCompressed();
+        solveAsDense = !sparseFactorization->factorize(A);
     }
 
     if (solveAsDense)
     {
 #ifndef NDEBUG
-        std::cout << "BSpline::Builder::computeBSplineCoefficients: Computing B-spline control points using dense solver." << std::endl;
+        std::cout << "BSpline::Builder::prepareDirectSolver: Computing B-spline control points using dense solver." << std::endl;
 #endif // NDEBUG
 
-        DenseMatrix Ad = A.toDense();
-        DenseQR<DenseVector> s;
-        // DenseSVD<DenseVector> s;
-        //bool successfulSolve = (s.solve(Ad,Bx,Cx) && s.solve(Ad,By,Cy));
-        if (!s.solve(Ad, b, x))
-        {
-            throw Exception("BSpline::Builder::computeBSplineCoefficients: Failed to solve for B-spline coefficients.");
-        }
+        denseFactorization = std::make_shared<DenseQRFactorization>();
+        if (!denseFactorization->factorize(A.toDense()))
+            throw Exception("BSpline::Builder::prepareDirectSolver: Failed to solve for B-spline coefficients.");
     }
 
-    return x;
+    bool normalEquations = (_smoothing != Smoothing::NONE);
+
+    return [=](const DenseMatrix &Y, SolverStatistics &statistics) -> DenseMatrix
+    {
+        statistics = SolverStatistics();
+
+        DenseMatrix rhs = normalEquations ? DenseMatrix(Bt*Y) : Y;
+
+        if (denseFactorization)
+            return denseFactorization->solve(rhs);
+
+        return sparseFactorization->solve(rhs);
+    };
 }
 
+/*
+ * Assembles the numSamples x numBasisFunctions basis matrix. Each row has exactly supportedPrInterval() entries
+ * (the tensor-product basis functions supported at the sample), so the row-major storage is allocated once
+ * and the rows are filled independently (in parallel if OpenMP is enabled).
+ * The basis functions of each variable are evaluated once per grid value, and each row is the tensor product
+ * of the values at the grid indices of the sample, so no knot intervals are searched per sample.
+ * Rows of samples outside the support are zero (stored as explicit zeros in the first columns).
+ */
 SparseMatrix BSpline::Builder::computeBasisFunctionMatrix(const BSpline &bspline) const
 {
     unsigned int numVariables = _data.getNumVariables();
-    unsigned int numSamples = _data.getNumSamples();
+    int numSamples = _data.getNumSamples();
+    int nnzPrRow = bspline.basis.supportedPrInterval();
+
+    const auto &grid = _data.getGrid();
+    std::vector<const unsigned int *> gridIndices(numVariables);
+    std::vector<unsigned int> numSupported(numVariables);
+    std::vector<int> numBasisFunctions(numVariables);
+    std::vector<std::vector<double>> univariate(numVariables); // numSupported values per grid value
+    std::vector<std::vector<int>> first(numVariables); // First supported basis function per grid value (-1 outside the support)
+
+    for (unsigned int dim = 0; dim < numVariables; ++dim)
+    {
+        BSplineBasis1D basis = bspline.basis.getSingleBasis(dim);
+        numSupported.at(dim) = basis.getBasisDegree() + 1;
+        numBasisFunctions.at(dim) = basis.getNumBasisFunctions();
+
+        univariate.at(dim).assign(grid.at(dim).size()*numSupported.at(dim), 0.0);
+        first.at(dim).assign(grid.at(dim).size(), -1);
+
+        for (unsigned int k = 0; k < grid.at(dim).size(); ++k)
+        {
+            double x = grid.at(dim).at(k);
+            if (basis.insideSupport(x))
+                first.at(dim).at(k) = basis.evalSupported(x, &univariate.at(dim).at(k*numSupported.at(dim)));
+        }
+
+        gridIndices.at(dim) = _data.getGridIndices(dim);
+    }
+
+    Eigen::SparseMatrix<double, Eigen::RowMajor> A(numSamples, bspline.getNumBasisFunctions());
+    A.resizeNonZeros(numSamples*nnzPrRow);
+
+    int *outer = A.outerIndexPtr();
+    int *inner = A.innerIndexPtr();
+    double *values = A.valuePtr();
+
+    for (int i = 0; i <= numSamples; ++i)
+        outer[i] = i*nnzPrRow;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < numSamples; ++i)
+    {
+        double *rowValues = values + i*nnzPrRow;
+        int *rowIndices = inner + i*nnzPrRow;
+
+        bool inside = true;
+        for (unsigned int dim = 0; dim < numVariables; ++dim)
+            inside = inside && first[dim][gridIndices[dim][i]] >= 0;
+
+        if (!inside)
+        {
+            for (int k = 0; k < nnzPrRow; ++k)
+            {
+                rowValues[k] = 0;
+                rowIndices[k] = k;
+            }
+            continue;
+        }
+
+        // Expand the Kronecker product one variable at a time, in place, as in BSplineBasis::evalSupportedTensorProduct
+        rowValues[0] = 1;
+        rowIndices[0] = 0;
+        int size = 1;
+
+        for (unsigned int dim = 0; dim < numVariables; ++dim)
+        {
+            int numSupportedDim = numSupported[dim];
+            unsigned int k = gridIndices[dim][i];
+            const double *factors = &univariate[dim][k*numSupportedDim];
+            int firstDim = first[dim][k];
+
+            for (int a = size - 1; a >= 0; --a)
+            {
+                double value = rowValues[a];
+                int index = rowIndices[a]*numBasisFunctions[dim] + firstDim;
+
+                for (int s = numSupportedDim - 1; s >= 0; --s)
+                {
+                    rowValues[a*numSupportedDim + s] = value*factors[s];
+                    rowIndices[a*numSupportedDim + s] = index + s;
+                }
+            }
+
+            size *= numSupportedDim;
+        }
+    }
+
+    // Convert to column-major storage (a single counting pass)
+    return SparseMatrix(A);
+}
+
+/*
+ * Prepares the solution of min ||B*x - b||^2 + alpha*||R||^2 on a complete grid, where the basis matrix is the Kronecker
+ * product B = B_0 x ... x B_(d-1) of the basis matrices of each variable evaluated at its grid values.
+ * Only the small per-variable matrices are factorized, and they are applied along each mode of b without forming B
+ * or the normal equations (the "array regression" approach of Currie, Durban and Eilers):
+ * - NONE: x = (P_0 x ... x P_(d-1))*b, where P_i is a least squares inverse of B_i.
+ * - IDENTITY: B'*B + alpha*I = U*(L_0 x ... x L_(d-1) + alpha*I)*U', with the eigendecompositions B_i'*B_i = U_i*L_i*U_i'
+ *   and U = U_0 x ... x U_(d-1).
+ * - PSPLINE: B'*B + alpha*D'*D, where D'*D is the sum over i of I x ... x D_i'*D_i x ... x I and D_i is the second order
+ *   difference matrix of variable i. Only for one variable is this diagonalized by the generalized eigenvectors of
+ *   (D_i'*D_i, B_i'*B_i), so the equations are solved by conjugate gradients, preconditioned with the Kronecker
+ *   structured system where the identity factors of the penalty are replaced by B_i'*B_i (which is exactly diagonalized).
+ */
+BSpline::FitPlan::CoefficientSolver BSpline::Builder::prepareKroneckerSolver(const BSpline &bspline) const
+{
+    if (!isGridWithoutDuplicates())
+        throw Exception("BSpline::Builder::prepareKroneckerSolver: Requires a complete grid without duplicate samples.");
+
+    std::vector<DenseMatrix> matrices = computeBasisFunctionMatrices(bspline);
+
+    if (_smoothing == Smoothing::NONE)
+    {
+        std::vector<DenseMatrix> inverses;
+        for (auto &Bi : matrices)
+        {
+            Eigen::ColPivHouseholderQR<DenseMatrix> qr(Bi);
+            inverses.push_back(qr.solve(DenseMatrix::Identity(Bi.rows(), Bi.rows())));
+        }
+
+        return [inverses](const DenseMatrix &Y, SolverStatistics &statistics) -> DenseMatrix
+        {
+            statistics = SolverStatistics();
+            return kroneckerProductApply(inverses, Y);
+        };
+    }
+
+    // Transposes for the right-hand side B'*b of the normal equations and the Gram matrices B_i'*B_i
+    std::vector<DenseMatrix> transposes;
+    std::vector<DenseMatrix> grams;
+    std::vector<int> dims;
+    for (auto &Bi : matrices)
+    {
+        transposes.push_back(Bi.transpose());
+        grams.push_back(Bi.transpose()*Bi);
+        dims.push_back(Bi.cols());
+    }
+
+    // Eigenvectors of each variable and the (Kronecker structured) diagonal of the transformed equations
+    std::vector<DenseMatrix> penalties;
+    std::vector<DenseMatrix> eigenvectors;
+    std::vector<DenseMatrix> eigenvectorsTransposed;
+    DenseVector diagonal = DenseVector::Constant(1, _smoothing == Smoothing::IDENTITY ? 1.0 : 0.0);
+
+    for (auto &G : grams)
+    {
+        DenseVector eigenvalues;
+
+        if (_smoothing == Smoothing::IDENTITY)
+        {
+            Eigen::SelfAdjointEigenSolver<DenseMatrix> es(G);
+            eigenvectors.push_back(es.eigenvectors());
+            eigenvalues = es.eigenvalues();
+        }
+        else
+        {
+            if (G.cols() < 3)
+                throw Exception("BSpline::Builder::prepareKroneckerSolver: Need at least three coefficients/basis function per variable.");
+
+            DenseMatrix Di = getSecondOrderFiniteDifferenceMatrix(G.cols());
+            penalties.push_back(Di.transpose()*Di);
+
+            Eigen::GeneralizedSelfAdjointEigenSolver<DenseMatrix> ges(penalties.back(), G);
+            if (ges.info() != Eigen::Success)
+                throw Exception("BSpline::Builder::prepareKroneckerSolver: The P-spline solver requires at least as many grid values as basis functions in each variable.");
+
+            eigenvectors.push_back(ges.eigenvectors());
+            eigenvalues = ges.eigenvalues();
+        }
+
+        eigenvectorsTransposed.push_back(eigenvectors.back().transpose());
+
+        // Kronecker product (IDENTITY) or Kronecker sum (PSPLINE) of the eigenvalues
+        DenseVector next(diagonal.size()*eigenvalues.size());
+        for (int a = 0; a < diagonal.size(); ++a)
+        {
+            for (int j = 0; j < eigenvalues.size(); ++j)
+            {
+                if (_smoothing == Smoothing::IDENTITY)
+                    next(a*eigenvalues.size() + j) = diagonal(a)*eigenvalues(j);
+                else
+                    next(a*eigenvalues.size() + j) = diagonal(a) + eigenvalues(j);
+            }
+        }
+        diagonal.swap(next);
+    }
 
-    // TODO: Reserve nnz per row (degree+1)
-    //int nnzPrCol = bspline.basis.supportedPrInterval();
+    if (_smoothing == Smoothing::IDENTITY)
+        diagonal.array() += _alpha;
+    else
+        diagonal = (1 + _alpha*diagonal.array()).matrix();
 
-    SparseMatrix A(numSamples, bspline.getNumBasisFunctions());
-    //A.reserve(DenseVector::Constant(numSamples, nnzPrCol)); // TODO: should reserve nnz per row!
+    // Solves the diagonalized system (for each column of R)
+    auto solveDiagonalized = [eigenvectors, eigenvectorsTransposed, diagonal](const DenseMatrix &R) -> DenseMatrix
+    {
+        DenseMatrix Z = kroneckerProductApply(eigenvectorsTransposed, R);
+        Z.array().colwise() /= diagonal.array();
+        return kroneckerProductApply(eigenvectors, Z);
+    };
 
-    int i = 0;
-    for (auto it = _data.cbegin(); it != _data.cend(); ++it, ++i)
+    if (_smoothing == Smoothing::IDENTITY || matrices.size() == 1)
     {
-        DenseVector xi(numVariables);
-        xi.setZero();
-        std::vector<double> xv = it->getX();
-        for (unsigned int j = 0; j < numVariables; ++j)
+        return [transposes, solveDiagonalized](const DenseMatrix &Y, SolverStatistics &statistics) -> DenseMatrix
         {
-            xi(j) = xv.at(j);
+            statistics = SolverStatistics();
+            return solveDiagonalized(kroneckerProductApply(transposes, Y));
+        };
+    }
+
+    double alpha = _alpha;
+    double tolerance = _tolerance;
+    unsigned int maxIterations = _maxIterations;
+
+    return solveColumnwise([=](const DenseVector &b, SolverStatistics &statistics) -> DenseVector
+    {
+        DenseVector rhs = kroneckerProductApply(transposes, b);
+
+        // Matrix-free product with B'*B + alpha*D'*D
+        LinearOperator normalMatrix;
+        normalMatrix.rows = normalMatrix.cols = rhs.size();
+        normalMatrix.apply = [&](const DenseVector &x) -> DenseVector
+        {
+            DenseVector y = kroneckerProductApply(grams, x);
+            for (unsigned int i = 0; i < penalties.size(); ++i)
+                y += alpha*kroneckerModeProduct(penalties.at(i), i, dims, x);
+            return y;
+        };
+        normalMatrix.applyTranspose = normalMatrix.apply;
+
+        LinearOperator preconditioner;
+        preconditioner.rows = preconditioner.cols = rhs.size();
+        preconditioner.apply = [&](const DenseVector &r) -> DenseVector { return solveDiagonalized(r); };
+        preconditioner.applyTranspose = preconditioner.apply;
+
+        return solveCG(normalMatrix, rhs, preconditioner, preconditioner.apply(rhs), tolerance, maxIterations, statistics);
+    });
+}
+
+/*
+ * Prepares the solution of min ||B*x - b||^2 + alpha*||R*x||^2 with LSQR or CGLS on the stacked system
+ * [B; sqrt(alpha)*R]*x = [b; 0], or with CG on the normal equations (B'*B + alpha*R'*R)*x = B'*b,
+ * using only products with B, R and their transposes.
+ * B is applied as a Kronecker product of the per-variable basis matrices when the grid has no duplicates.
+ * All methods are preconditioned with the Kronecker product of the Cholesky factors of the per-variable normal matrices
+ * M_i = B_i'*B_i (+ alpha^(1/d)*I for IDENTITY, + alpha*D_i'*D_i for PSPLINE), evaluated on the grid values.
+ */
+BSpline::FitPlan::CoefficientSolver BSpline::Builder::prepareIterativeSolver(const BSpline &bspline) const
+{
+    std::vector<DenseMatrix> matrices = computeBasisFunctionMatrices(bspline);
+    int numSamples = _data.getNumSamples();
+    int numCoefficients = bspline.getNumBasisFunctions();
+
+    // Basis matrix, as a Kronecker product (if there are no duplicates) or as a sparse matrix
+    bool kronecker = isGridWithoutDuplicates();
+    std::vector<DenseMatrix> transposes;
+    SparseMatrix Bs;
+    if (kronecker)
+    {
+        for (auto &Bi : matrices)
+            transposes.push_back(Bi.transpose());
+    }
+    else
+    {
+        Bs = computeBasisFunctionMatrix(bspline);
+    }
+
+    /*
+     * Regularization operator R. For PSPLINE, the rows of D (see getSecondOrderFiniteDifferenceMatrix) are the second order
+     * differences along each variable, which are applied as D_i along mode i, one block of rows per variable.
+     */
+    std::vector<int> dims;
+    for (auto &Bi : matrices)
+        dims.push_back(Bi.cols());
+
+    std::vector<DenseMatrix> differences;
+    std::vector<int> numBlockRows;
+    int numPenaltyRows = 0;
+
+    if (_smoothing == Smoothing::IDENTITY)
+    {
+        numPenaltyRows = numCoefficients;
+    }
+    else if (_smoothing == Smoothing::PSPLINE)
+    {
+        for (unsigned int i = 0; i < dims.size(); ++i)
+        {
+            if (dims.at(i) < 3)
+                throw Exception("BSpline::Builder::prepareIterativeSolver: Need at least three coefficients/basis function per variable.");
+
+            differences.push_back(getSecondOrderFiniteDifferenceMatrix(dims.at(i)));
+            numBlockRows.push_back(numCoefficients/dims.at(i)*(dims.at(i) - 2));
+            numPenaltyRows += numBlockRows.back();
         }
+    }
 
-        SparseVector basisValues = bspline.evalBasis(xi);
+    // Kronecker product of the inverse Cholesky factors
+    std::vector<DenseMatrix> inverseFactors;
+    std::vector<DenseMatrix> inverseFactorsTransposed;
+    for (auto &Bi : matrices)
+    {
+        DenseMatrix M = Bi.transpose()*Bi;
+        DenseMatrix I = DenseMatrix::Identity(M.rows(), M.cols());
 
-        for (SparseVector::InnerIterator it2(basisValues); it2; ++it2)
+        if (_smoothing == Smoothing::IDENTITY)
+        {
+            M += std::pow(_alpha, 1.0/matrices.size())*I;
+        }
+        else if (_smoothing == Smoothing::PSPLINE)
         {
-            A.insert(i,it2.index()) = it2.value();
+            DenseMatrix Di = getSecondOrderFiniteDifferenceMatrix(M.cols());
+            M += _alpha*Di.transpose()*Di;
         }
+
+        // Shift to keep M positive definite when there are fewer grid values than basis functions
+        M += 1e-10*M.trace()/M.cols()*I;
+
+        Eigen::LLT<DenseMatrix> llt(M);
+        if (llt.info() != Eigen::Success)
+            throw Exception("BSpline::Builder::prepareIterativeSolver: Failed to compute the preconditioner.");
+
+        DenseMatrix inverseL = llt.matrixL().solve(I);
+        inverseFactors.push_back(inverseL.transpose());
+        inverseFactorsTransposed.push_back(inverseL);
     }
 
-    A.makeCompressed();
+    Solver solver = _solver;
+    bool pspline = (_smoothing == Smoothing::PSPLINE);
+    double alpha = _alpha;
+    double tolerance = _tolerance;
+    unsigned int maxIterations = _maxIterations;
+
+    return solveColumnwise([=](const DenseVector &b, SolverStatistics &statistics) -> DenseVector
+    {
+        // Basis matrix operator
+        LinearOperator B;
+        B.rows = numSamples;
+        B.cols = numCoefficients;
+
+        if (kronecker)
+        {
+            B.apply = [&](const DenseVector &x) -> DenseVector { return kroneckerProductApply(matrices, x); };
+            B.applyTranspose = [&](const DenseVector &y) -> DenseVector { return kroneckerProductApply(transposes, y); };
+        }
+        else
+        {
+            B.apply = [&](const DenseVector &x) -> DenseVector { return Bs*x; };
+            B.applyTranspose = [&](const DenseVector &y) -> DenseVector { return Bs.transpose()*y; };
+        }
+
+        auto applyR = [&](const DenseVector &x) -> DenseVector
+        {
+            if (!pspline)
+                return x;
+
+            DenseVector y(numPenaltyRows);
+            for (unsigned int i = 0, offset = 0; i < differences.size(); offset += numBlockRows.at(i), ++i)
+                y.segment(offset, numBlockRows.at(i)) = kroneckerModeProduct(differences.at(i), i, dims, x);
+            return y;
+        };
 
-    return A;
+        auto applyRTranspose = [&](const DenseVector &y) -> DenseVector
+        {
+            if (!pspline)
+                return y;
+
+            DenseVector x = DenseVector::Zero(numCoefficients);
+            for (unsigned int i = 0, offset = 0; i < differences.size(); offset += numBlockRows.at(i), ++i)
+            {
+                std::vector<int> blockDims = dims;
+                blockDims.at(i) -= 2;
+                x += kroneckerModeProduct(differences.at(i).transpose(), i, blockDims, y.segment(offset, numBlockRows.at(i)));
+            }
+            return x;
+        };
+
+        // Right preconditioner R^-1 = L_0^-T x ... x L_(d-1)^-T
+        LinearOperator preconditioner;
+        preconditioner.rows = preconditioner.cols = numCoefficients;
+        preconditioner.apply = [&](const DenseVector &x) -> DenseVector { return kroneckerProductApply(inverseFactors, x); };
+        preconditioner.applyTranspose = [&](const DenseVector &x) -> DenseVector { return kroneckerProductApply(inverseFactorsTransposed, x); };
+
+        if (solver == Solver::CG)
+        {
+            LinearOperator normalMatrix;
+            normalMatrix.rows = normalMatrix.cols = numCoefficients;
+            normalMatrix.apply = [&](const DenseVector &x) -> DenseVector
+            {
+                DenseVector y = B.applyTranspose(B.apply(x));
+                if (numPenaltyRows > 0)
+                    y += alpha*applyRTranspose(applyR(x));
+                return y;
+            };
+            normalMatrix.applyTranspose = normalMatrix.apply;
+
+            LinearOperator inverse;
+            inverse.rows = inverse.cols = numCoefficients;
+            inverse.apply = [&](const DenseVector &r) -> DenseVector { return preconditioner.apply(preconditioner.applyTranspose(r)); };
+            inverse.applyTranspose = inverse.apply;
+
+            return solveCG(normalMatrix, B.applyTranspose(b), inverse, DenseVector::Zero(numCoefficients),
+                           tolerance, maxIterations, statistics);
+        }
+
+        // Stacked least squares system [B; sqrt(alpha)*R]
+        double sqrtAlpha = std::sqrt(alpha);
+
+        LinearOperator A;
+        A.rows = B.rows + numPenaltyRows;
+        A.cols = numCoefficients;
+        A.apply = [&](const DenseVector &x) -> DenseVector
+        {
+            DenseVector y(A.rows);
+            y.head(B.rows) = B.apply(x);
+            if (numPenaltyRows > 0)
+                y.tail(numPenaltyRows) = sqrtAlpha*applyR(x);
+            return y;
+        };
+        A.applyTranspose = [&](const DenseVector &y) -> DenseVector
+        {
+            DenseVector x = B.applyTranspose(y.head(B.rows));
+            if (numPenaltyRows > 0)
+                x += sqrtAlpha*applyRTranspose(y.tail(numPenaltyRows));
+            return x;
+        };
+
+        DenseVector rhs = DenseVector::Zero(A.rows);
+        rhs.head(B.rows) = b;
+
+        if (solver == Solver::LSQR)
+            return solveLSQR(A, rhs, preconditioner, tolerance, maxIterations, statistics);
+
+        return solveCGLS(A, rhs, preconditioner, tolerance, maxIterations, statistics);
+    });
 }
 
-DenseVector BSpline::Builder::getSamplePointValues() const
+/*
+ * Computes the (dense) basis matrix of each variable, evaluated at the grid values of that variable.
+ * On a complete grid without duplicates, the basis matrix is the Kronecker product of these matrices.
+ */
+std::vector<DenseMatrix> BSpline::Builder::computeBasisFunctionMatrices(const BSpline &bspline) const
+{
+    const auto &grid = _data.getGrid();
+
+    std::vector<DenseMatrix> matrices;
+    for (unsigned int dim = 0; dim < _data.getNumVariables(); ++dim)
+    {
+        BSplineBasis1D basis = bspline.basis.getSingleBasis(dim);
+
+        DenseMatrix Bi = DenseMatrix::Zero(grid.at(dim).size(), basis.getNumBasisFunctions());
+
+        int i = 0;
+        for (double x : grid.at(dim))
+        {
+            SparseVector values = basis.eval(x);
+            for (SparseVector::InnerIterator it(values); it; ++it)
+                Bi(i, it.index()) = it.value();
+            ++i;
+        }
+
+        matrices.push_back(Bi);
+    }
+
+    return matrices;
+}
+
+bool BSpline::Builder::isGridWithoutDuplicates() const
 {
-    DenseVector B = DenseVector::Zero(_data.getNumSamples());
+    unsigned int numGridPoints = 1;
+    for (auto &values : _data.getGrid())
+        numGridPoints *= values.size();
 
-    int i = 0;
-    for (auto it = _data.cbegin(); it != _data.cend(); ++it, ++i)
-        B(i) = it->getY();
+    return _data.isGridComplete() && numGridPoints == _data.getNumSamples();
+}
 
-    return B;
+DenseVector BSpline::Builder::getSamplePointValues() const
+{
+    return Eigen::Map<const DenseVector>(_data.getColumnY(), _data.getNumSamples());
 }
 
 /*
@@ -311,13 +945,27 @@ SparseMatrix BSpline::Builder::getSecondOrderFiniteDifferenceMatrix(const BSplin
     return D;
 }
 
+// Second order finite difference matrix of one variable with n coefficients, (n-2) x n with rows [1 -2 1]
+DenseMatrix BSpline::Builder::getSecondOrderFiniteDifferenceMatrix(unsigned int n) const
+{
+    DenseMatrix D = DenseMatrix::Zero(n - 2, n);
+    for (unsigned int k = 0; k + 2 < n; ++k)
+    {
+        D(k, k) = 1;
+        D(k, k + 1) = -2;
+        D(k, k + 2) = 1;
+    }
+    return D;
+}
+
 // Compute all knot vectors from sample data
 std::vector<std::vector<double> > BSpline::Builder::computeKnotVectors() const
 {
     if (_data.getNumVariables() != _degrees.size())
         throw Exception("BSpline::Builder::computeKnotVectors: Inconsistent sizes on input vectors.");
 
-    std::vector<std::vector<double>> grid = _data.getTableX();
+    // The knot vectors depend only on the unique values of each variable, so the samples are not copied
+    const auto &grid = _data.getGrid();
 
     std::vector<std::vector<double>> knotVectors;
 
@@ -555,4 +1203,203 @@ std::vector<double> BSpline::Builder::extractUniqueSorted(const std::vector<doub
     return unique;
 }
 
+BSpline::FitPlan::FitPlan(const BSpline &bspline, unsigned int numSamples, CoefficientSolver solver)
+    : _bspline(bspline),
+      _numSamples(numSamples),
+      _solver(solver)
+{
+}
+
+BSpline BSpline::FitPlan::fit(const DenseVector &y) const
+{
+    SolverStatistics statistics;
+    BSpline bspline = fit(y, statistics);
+
+    if (!statistics.converged)
+        throw Exception("BSpline::FitPlan::fit: The iterative solver did not converge.");
+
+    return bspline;
+}
+
+BSpline BSpline::FitPlan::fit(const DenseVector &y, SolverStatistics &statistics) const
+{
+    BSpline bspline(_bspline);
+    bspline.setCoefficients(fitCoefficients(y, statistics).col(0));
+    return bspline;
+}
+
+std::vector<BSpline> BSpline::FitPlan::fit(const DenseMatrix &Y) const
+{
+    SolverStatistics statistics;
+    std::vector<BSpline> bsplines = fit(Y, statistics);
+
+    if (!statistics.converged)
+        throw Exception("BSpline::FitPlan::fit: The iterative solver did not converge.");
+
+    return bsplines;
+}
+
+std::vector<BSpline> BSpline::FitPlan::fit(const DenseMatrix &Y, SolverStatistics &statistics) const
+{
+    DenseMatrix coefficients = fitCoefficients(Y, statistics);
+
+    std::vector<BSpline> bsplines(coefficients.cols(), _bspline);
+    for (int j = 0; j < coefficients.cols(); ++j)
+        bsplines.at(j).setCoefficients(coefficients.col(j));
+
+    return bsplines;
+}
+
+DenseMatrix BSpline::FitPlan::fitCoefficients(const DenseMatrix &Y, SolverStatistics &statistics) const
+{
+    if (Y.rows() != (int)_numSamples)
+        throw Exception("BSpline::FitPlan::fitCoefficients: Expected one row of sample values per sample.");
+
+    return _solver(Y, statistics);
+}
+
+BSpline::OnlineFit::OnlineFit(const BSpline &bspline, const SparseMatrix &A, const DenseVector &rhs, unsigned int numSamples, double forgettingFactor)
+    : _bspline(bspline),
+      _A(A),
+      _rhs(rhs),
+      _scale(1),
+      _numSamples(numSamples),
+      _forgettingFactor(forgettingFactor),
+      _factorization(new Factorization()),
+      _factorized(false)
+{
+}
+
+BSpline::OnlineFit::OnlineFit(const OnlineFit &other)
+    : _bspline(other._bspline),
+      _A(other._A),
+      _rhs(other._rhs),
+      _scale(other._scale),
+      _numSamples(other._numSamples),
+      _forgettingFactor(other._forgettingFactor),
+      _factorization(new Factorization()),
+      _factorized(false)
+{
+    analyzePattern();
+}
+
+BSpline::OnlineFit &BSpline::OnlineFit::operator=(const OnlineFit &other)
+{
+    if (this == &other)
+        return *this;
+
+    _bspline = other._bspline;
+    _A = other._A;
+    _rhs = other._rhs;
+    _scale = other._scale;
+    _numSamples = other._numSamples;
+    _forgettingFactor = other._forgettingFactor;
+    _factorization.reset(new Factorization());
+    _factorized = false;
+    analyzePattern();
+
+    return *this;
+}
+
+void BSpline::OnlineFit::addSample(const DataPoint &sample)
+{
+    addSample(sample.getX(), sample.getY());
+}
+
+void BSpline::OnlineFit::addSample(const std::vector<double> &x, double y)
+{
+    addSample(vectorToDenseVector(x), y);
+}
+
+/*
+ * Updates A = lambda*A + b*b' and B'*y = lambda*B'*y + y*b, where b holds the basis functions at x.
+ * A and B'*y are stored divided by the accumulated factor _scale, so forgetting only updates _scale
+ * (and rescales the stored equations, in O(nnz), on the rare occasions where _scale would underflow).
+ */
+void BSpline::OnlineFit::addSample(const DenseVector &x, double y)
+{
+    if (x.size() != _bspline.getNumVariables())
+        throw Exception("BSpline::OnlineFit::addSample: Wrong dimension on sample point x.");
+
+    // Stack storage for the supported basis functions, unless there are many
+    const int maxStackSupported = 1024;
+    double valueBuffer[maxStackSupported];
+    int indexBuffer[maxStackSupported];
+    std::vector<double> heapValues;
+    std::vector<int> heapIndices;
+    double *values = valueBuffer;
+    int *indices = indexBuffer;
+
+    int nnz = _bspline.basis.supportedPrInterval();
+    if (nnz > maxStackSupported)
+    {
+        heapValues.resize(nnz);
+        heapIndices.resize(nnz);
+        values = heapValues.data();
+        indices = heapIndices.data();
+    }
+
+    if (!_bspline.basis.evalSupportedTensorProduct(x.data(), values, indices))
+        throw Exception("BSpline::OnlineFit::addSample: The sample point is outside the support of the B-spline.");
+
+    if (_forgettingFactor < 1)
+    {
+        _scale *= _forgettingFactor;
+
+        if (_scale < 1e-100)
+        {
+            _A *= _scale;
+            _rhs *= _scale;
+            _scale = 1;
+        }
+    }
+
+    // The indices are increasing, so (indices[k], indices[l]) with l <= k is in the lower triangle
+    for (int k = 0; k < nnz; ++k)
+    {
+        double weighted = values[k]/_scale;
+        _rhs(indices[k]) += y*weighted;
+
+        for (int l = 0; l <= k; ++l)
+            _A.coeffRef(indices[k], indices[l]) += weighted*values[l];
+    }
+
+    _factorized = false;
+    ++_numSamples;
+}
+
+void BSpline::OnlineFit::analyzePattern()
+{
+    _factorization->analyzePattern(_A);
+    _factorized = false;
+}
+
+const BSpline::OnlineFit::Factorization &BSpline::OnlineFit::factorize() const
+{
+    if (!_factorized)
+    {
+        _factorization->factorize(_A);
+
+        if (_factorization->info() != Eigen::Success || !(_factorization->vectorD().minCoeff() > 0))
+            throw Exception("BSpline::OnlineFit::factorize: The normal equations of the samples are singular (add samples or use smoothing).");
+
+        _factorized = true;
+    }
+
+    return *_factorization;
+}
+
+// The scale of the stored equations cancels in the solution
+DenseVector BSpline::OnlineFit::getCoefficients() const
+{
+    return factorize().solve(_rhs);
+}
+
+BSpline BSpline::OnlineFit::getBSpline() const
+{
+    BSpline bspline(_bspline);
+    bspline.setCoefficients(getCoefficients());
+    return bspline;
+}
+
 } // namespace SPLINTER
\ No newline at end of file
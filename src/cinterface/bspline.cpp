@@ -237,12 +237,9 @@ double *splinter_bspline_eval_row_major(splinter_obj_ptr bspline_ptr, double *x,
             size_t num_points = x_len / num_variables;
 
             retVal = (double *) malloc(sizeof(double) * num_points);
-            for (size_t i = 0; i < num_points; ++i)
-            {
-                auto xvec = get_densevector<double>(x, num_variables);
-                retVal[i] = bspline->eval(xvec);
-                x += num_variables;
-            }
+            DenseMatrix xmat = get_densematrix<double>(x, num_points, num_variables);
+            Eigen::Map<DenseVector> values(retVal, num_points);
+            bspline->evalBatch(xmat, values);
         }
         catch(const Exception &e)
         {
@@ -266,15 +263,12 @@ double *splinter_bspline_eval_jacobian_row_major(splinter_obj_ptr bspline_ptr, d
             size_t num_points = x_len / num_variables;
 
             retVal = (double *) malloc(sizeof(double) * num_variables * num_points);
-            for (size_t i = 0; i < num_points; ++i)
-            {
-                auto xvec = get_densevector<double>(x, num_variables);
-                DenseMatrix jacobian = bspline->evalJacobian(xvec);
+            DenseMatrix xmat = get_densematrix<double>(x, num_points, num_variables);
+            DenseMatrix jacobians(num_points, num_variables);
+            bspline->evalJacobianBatch(xmat, jacobians);
 
-                /* Copy jacobian from stack to heap */
-                memcpy(retVal + i*num_variables, jacobian.data(), sizeof(double) * num_variables);
-                x += num_variables;
-            }
+            /* Copy jacobians to the heap in row major order */
+            Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(retVal, num_points, num_variables) = jacobians;
         }
         catch(const Exception &e)
         {
@@ -317,6 +311,59 @@ double *splinter_bspline_eval_hessian_row_major(splinter_obj_ptr bspline_ptr, do
     return retVal;
 }
 
+double *splinter_bspline_eval_all_row_major(splinter_obj_ptr bspline_ptr, double *x, int x_len, int order)
+{
+    double *retVal = nullptr;
+
+    auto bspline = get_bspline(bspline_ptr);
+    if (bspline != nullptr)
+    {
+        try
+        {
+            if (order < 0 || order > 2)
+            {
+                throw Exception("splinter_bspline_eval_all_row_major: Order must be 0, 1 or 2.");
+            }
+
+            size_t num_variables = bspline->getNumVariables();
+            size_t num_points = x_len / num_variables;
+
+            /* Value, jacobian and hessian of each point */
+            size_t block_size = 1;
+            if (order >= 1) block_size += num_variables;
+            if (order >= 2) block_size += num_variables * num_variables;
+
+            retVal = (double *) malloc(sizeof(double) * block_size * num_points);
+            for (size_t i = 0; i < num_points; ++i)
+            {
+                auto xvec = get_densevector<double>(x, num_variables);
+                BSpline::Evaluation evaluation = bspline->evalAll(xvec, order);
+
+                double *block = retVal + i*block_size;
+                block[0] = evaluation.value;
+                if (order >= 1)
+                {
+                    memcpy(block + 1, evaluation.jacobian.data(), sizeof(double) * num_variables);
+                }
+                if (order >= 2)
+                {
+                    /* The hessian is symmetric, so column and row major order coincide */
+                    memcpy(block + 1 + num_variables, evaluation.hessian.data(), sizeof(double) * num_variables * num_variables);
+                }
+                x += num_variables;
+            }
+        }
+        catch(const Exception &e)
+        {
+            free(retVal);
+            retVal = nullptr;
+            set_error_string(e.what());
+        }
+    }
+
+    return retVal;
+}
+
 double *splinter_bspline_eval_col_major(splinter_obj_ptr bspline_ptr, double *x, int x_len)
 {
     double *retVal = nullptr;
@@ -400,6 +447,33 @@ double *splinter_bspline_eval_hessian_col_major(splinter_obj_ptr bspline_ptr, do
     return retVal;
 }
 
+double *splinter_bspline_eval_all_col_major(splinter_obj_ptr bspline_ptr, double *x, int x_len, int order)
+{
+    double *retVal = nullptr;
+
+    auto bspline = get_bspline(bspline_ptr);
+    if (bspline != nullptr)
+    {
+        double *row_major = nullptr;
+        try
+        {
+            row_major = get_row_major(x, bspline->getNumVariables(), x_len);
+            if (row_major == nullptr)
+            {
+                return nullptr; // Pass on the error message set by get_row_major
+            }
+
+            retVal = splinter_bspline_eval_all_row_major(bspline, row_major, x_len, order);
+        }
+        catch(const Exception &e)
+        {
+            set_error_string(e.what());
+        }
+        free(row_major);
+    }
+    return retVal;
+}
+
 int splinter_bspline_get_num_variables(splinter_obj_ptr bspline_ptr)
 {
     int retVal = 0;
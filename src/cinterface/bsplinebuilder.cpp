@@ -8,6 +8,7 @@
 */
 
 #include "bsplinebuilder.h"
+#include "vectorbspline.h"
 #include "cinterface/cinterface.h"
 #include "cinterface/utilities.h"
 //#include <fstream>
@@ -130,6 +131,36 @@ splinter_obj_ptr splinter_bspline_builder_build(splinter_obj_ptr bspline_builder
     return bspline;
 }
 
+splinter_obj_ptr splinter_bspline_builder_build_vector(splinter_obj_ptr bspline_builder_ptr, double *y, int num_samples, int num_outputs)
+{
+    auto builder = get_builder(bspline_builder_ptr);
+    if (builder == nullptr)
+    {
+        return nullptr;
+    }
+
+    splinter_obj_ptr vector_bspline = nullptr;
+
+    try
+    {
+        if (num_samples < 0 || num_outputs <= 0)
+        {
+            throw Exception("splinter_bspline_builder_build_vector: Invalid size of y.");
+        }
+
+        DenseMatrix Y = get_densematrix<double>(y, num_samples, num_outputs);
+
+        vector_bspline = new VectorBSpline(builder->build(Y));
+        vector_bsplines.insert(vector_bspline);
+    }
+    catch (const Exception &e)
+    {
+        set_error_string(e.what());
+    }
+
+    return vector_bspline;
+}
+
 void splinter_bspline_builder_delete(splinter_obj_ptr bspline_builder_ptr)
 {
     auto builder = get_builder(bspline_builder_ptr);
@@ -10,6 +10,7 @@
 #include "cinterface/cinterface.h"
 #include "cinterface/utilities.h"
 #include "datatable.h"
+#include <algorithm>
 //#include <fstream>
 
 using namespace SPLINTER;
@@ -51,28 +52,17 @@ void splinter_datatable_add_samples_row_major(splinter_obj_ptr datatable_ptr, do
     {
         try
         {
-//            std::ofstream out("test.txt");
-            DenseVector vec(x_dim);
+            // Each row is a sample point followed by its y-value
+            std::vector<double> X(n_samples * x_dim);
+            std::vector<double> y(n_samples);
             for (int i = 0; i < n_samples; ++i)
             {
                 int sample_start = i*(x_dim+1);
-                for (int offset = 0; offset < x_dim; ++offset)
-                {
-                    vec(offset) = x[sample_start + offset];
-                }
-
-//                out << "Adding sample: (";
-//                for(int l = 0; l < vec.size(); l++)
-//                {
-//                    if(l != 0)
-//                        out << ",";
-//                    out << vec(l);
-//                }
-//                out << ") = ";
-//                out  << x[sample_start + x_dim] << std::endl;
-
-                dataTable->addSample(vec, x[sample_start + x_dim]);
+                std::copy(x + sample_start, x + sample_start + x_dim, X.begin() + i*x_dim);
+                y.at(i) = x[sample_start + x_dim];
             }
+
+            dataTable->addSamples(X.data(), y.data(), n_samples, x_dim, DataTable::Layout::ROW_MAJOR);
         }
         catch(const Exception &e)
         {
@@ -88,27 +78,8 @@ void splinter_datatable_add_samples_col_major(splinter_obj_ptr datatable_ptr, do
     {
         try
         {
-//            std::ofstream out("test.txt");
-            DenseVector vec(x_dim);
-            for (int i = 0; i < n_samples; ++i)
-            {
-                for (int j = 0; j < x_dim; ++j)
-                {
-                    vec(j) = x[i + j * n_samples];
-                }
-
-//                out << "Adding sample: (";
-//                for(int l = 0; l < vec.size(); l++)
-//                {
-//                    if(l != 0)
-//                        out << ",";
-//                    out << vec(l);
-//                }
-//                out << ") = ";
-//                out  << x[i + x_dim * n_samples] << std::endl;
-
-                dataTable->addSample(vec, x[i + x_dim * n_samples]);
-            }
+            // The first x_dim columns are the sample points, and the last column the y-values
+            dataTable->addSamples(x, x + x_dim * n_samples, n_samples, x_dim, DataTable::Layout::COLUMN_MAJOR);
         }
         catch(const Exception &e)
         {
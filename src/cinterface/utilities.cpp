@@ -16,6 +16,7 @@ namespace SPLINTER
 std::set<splinter_obj_ptr> dataTables = std::set<splinter_obj_ptr>();
 std::set<splinter_obj_ptr> bsplines = std::set<splinter_obj_ptr>();
 std::set<splinter_obj_ptr> bspline_builders = std::set<splinter_obj_ptr>();
+std::set<splinter_obj_ptr> vector_bsplines = std::set<splinter_obj_ptr>();
 
 // 1 if the last function call caused an error, 0 else
 int splinter_last_func_call_error = 0;
@@ -54,6 +55,19 @@ BSpline *get_bspline(splinter_obj_ptr bspline_ptr)
     return nullptr;
 }
 
+/* Cast the splinter_obj_ptr to a VectorBSpline * */
+VectorBSpline *get_vector_bspline(splinter_obj_ptr vector_bspline_ptr)
+{
+    if (vector_bsplines.count(vector_bspline_ptr) > 0)
+    {
+        return static_cast<VectorBSpline *>(vector_bspline_ptr);
+    }
+
+    set_error_string("Invalid reference to VectorBSpline: Maybe it has been deleted?");
+
+    return nullptr;
+}
+
 /* Check for existence of bspline_builder_ptr, then cast splinter_obj_ptr to a BSpline::Builder * */
 BSpline::Builder *get_builder(splinter_obj_ptr bspline_builder_ptr)
 {
@@ -0,0 +1,211 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "vectorbspline.h"
+#include "cinterface/utilities.h"
+
+using namespace SPLINTER;
+
+extern "C"
+{
+
+splinter_obj_ptr splinter_vector_bspline_load_init(const char *filename)
+{
+    splinter_obj_ptr vector_bspline = nullptr;
+
+    try
+    {
+        vector_bspline = (splinter_obj_ptr) new VectorBSpline(filename);
+        vector_bsplines.insert(vector_bspline);
+    }
+    catch(const Exception &e)
+    {
+        set_error_string(e.what());
+    }
+
+    return vector_bspline;
+}
+
+double *splinter_vector_bspline_eval_row_major(splinter_obj_ptr vector_bspline_ptr, double *x, int x_len)
+{
+    double *retVal = nullptr;
+
+    auto vector_bspline = get_vector_bspline(vector_bspline_ptr);
+    if (vector_bspline != nullptr)
+    {
+        try
+        {
+            size_t num_variables = vector_bspline->getNumVariables();
+            size_t num_outputs = vector_bspline->getNumOutputs();
+            size_t num_points = x_len / num_variables;
+
+            retVal = (double *) malloc(sizeof(double) * num_outputs * num_points);
+            for (size_t i = 0; i < num_points; ++i)
+            {
+                vector_bspline->eval(x, retVal + i*num_outputs);
+                x += num_variables;
+            }
+        }
+        catch(const Exception &e)
+        {
+            free(retVal);
+            retVal = nullptr;
+            set_error_string(e.what());
+        }
+    }
+
+    return retVal;
+}
+
+double *splinter_vector_bspline_eval_jacobian_row_major(splinter_obj_ptr vector_bspline_ptr, double *x, int x_len)
+{
+    double *retVal = nullptr;
+
+    auto vector_bspline = get_vector_bspline(vector_bspline_ptr);
+    if (vector_bspline != nullptr)
+    {
+        try
+        {
+            size_t num_variables = vector_bspline->getNumVariables();
+            size_t num_outputs = vector_bspline->getNumOutputs();
+            size_t num_points = x_len / num_variables;
+            size_t block_size = num_outputs * num_variables;
+
+            retVal = (double *) malloc(sizeof(double) * block_size * num_points);
+            DenseMatrix jacobian(num_outputs, num_variables);
+            for (size_t i = 0; i < num_points; ++i)
+            {
+                vector_bspline->evalJacobian(x, jacobian.data());
+
+                /* Copy jacobian to the heap in row major order */
+                Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(retVal + i*block_size, num_outputs, num_variables) = jacobian;
+                x += num_variables;
+            }
+        }
+        catch(const Exception &e)
+        {
+            free(retVal);
+            retVal = nullptr;
+            set_error_string(e.what());
+        }
+    }
+
+    return retVal;
+}
+
+double *splinter_vector_bspline_eval_col_major(splinter_obj_ptr vector_bspline_ptr, double *x, int x_len)
+{
+    double *retVal = nullptr;
+
+    auto vector_bspline = get_vector_bspline(vector_bspline_ptr);
+    if (vector_bspline != nullptr)
+    {
+        double *row_major = nullptr;
+        try
+        {
+            row_major = get_row_major(x, vector_bspline->getNumVariables(), x_len);
+            if (row_major == nullptr)
+            {
+                return nullptr; // Pass on the error message set by get_row_major
+            }
+
+            retVal = splinter_vector_bspline_eval_row_major(vector_bspline, row_major, x_len);
+        }
+        catch(const Exception &e)
+        {
+            set_error_string(e.what());
+        }
+        free(row_major);
+    }
+
+    return retVal;
+}
+
+double *splinter_vector_bspline_eval_jacobian_col_major(splinter_obj_ptr vector_bspline_ptr, double *x, int x_len)
+{
+    double *retVal = nullptr;
+
+    auto vector_bspline = get_vector_bspline(vector_bspline_ptr);
+    if (vector_bspline != nullptr)
+    {
+        double *row_major = nullptr;
+        try
+        {
+            row_major = get_row_major(x, vector_bspline->getNumVariables(), x_len);
+            if (row_major == nullptr)
+            {
+                return nullptr; // Pass on the error message set by get_row_major
+            }
+
+            retVal = splinter_vector_bspline_eval_jacobian_row_major(vector_bspline, row_major, x_len);
+        }
+        catch(const Exception &e)
+        {
+            set_error_string(e.what());
+        }
+        free(row_major);
+    }
+
+    return retVal;
+}
+
+int splinter_vector_bspline_get_num_variables(splinter_obj_ptr vector_bspline_ptr)
+{
+    int retVal = 0;
+
+    auto vector_bspline = get_vector_bspline(vector_bspline_ptr);
+    if (vector_bspline != nullptr)
+    {
+        retVal = vector_bspline->getNumVariables();
+    }
+
+    return retVal;
+}
+
+int splinter_vector_bspline_get_num_outputs(splinter_obj_ptr vector_bspline_ptr)
+{
+    int retVal = 0;
+
+    auto vector_bspline = get_vector_bspline(vector_bspline_ptr);
+    if (vector_bspline != nullptr)
+    {
+        retVal = vector_bspline->getNumOutputs();
+    }
+
+    return retVal;
+}
+
+void splinter_vector_bspline_save(splinter_obj_ptr vector_bspline_ptr, const char *filename)
+{
+    auto vector_bspline = get_vector_bspline(vector_bspline_ptr);
+    if (vector_bspline != nullptr)
+    {
+        try
+        {
+            vector_bspline->save(filename);
+        }
+        catch(const Exception &e)
+        {
+            set_error_string(e.what());
+        }
+    }
+}
+
+void splinter_vector_bspline_delete(splinter_obj_ptr vector_bspline_ptr)
+{
+    auto vector_bspline = get_vector_bspline(vector_bspline_ptr);
+
+    if (vector_bspline != nullptr)
+    {
+        vector_bsplines.erase(vector_bspline_ptr);
+        delete vector_bspline;
+    }
+}
+
+} // extern "C"
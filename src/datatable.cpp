@@ -13,12 +13,85 @@
 #include <iomanip>
 #include <stdexcept>
 #include <limits>
+#include <cmath>
 #include <serializer.h>
 #include <initializer_list>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <clocale>
+#include <chrono>
+#include <unordered_set>
+#include <unordered_map>
+#ifdef _OPENMP
+#include <omp.h>
+#endif // _OPENMP
+#if defined(__unix__) || defined(__APPLE__)
+#define SPLINTER_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif // __APPLE__
 
 namespace SPLINTER
 {
 
+/*
+ * Header of the columnar file format (version 1). The header is followed by numVariables arrays of x-values and
+ * one array of y-values, each holding numSamples doubles and starting at a multiple of columnStride bytes after
+ * the header. The samples are sorted (as written by saveColumnar), so a mapped table needs no sorting.
+ */
+struct ColumnarHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;     // columnarByteOrder in the byte order of the writer
+    uint32_t numVariables;
+    uint32_t flags;         // 1 = allowDuplicates, 2 = allowIncompleteGrid
+    uint64_t numSamples;
+    uint64_t numDuplicates;
+    uint64_t columnStride;  // Bytes, a multiple of columnarAlignment
+    uint64_t reserved[2];
+};
+
+static_assert(sizeof(ColumnarHeader) == 64, "ColumnarHeader must be 64 bytes");
+
+static const char columnarMagic[8] = {'S', 'P', 'L', 'D', 'T', 'C', 'O', 'L'};
+static const uint32_t columnarVersion = 1;
+static const uint32_t columnarByteOrder = 0x01020304;
+static const uint64_t columnarAlignment = 64;
+
+/*
+ * A mapped columnar file. Without mmap, the file is read into buffer instead.
+ */
+struct DataTable::MappedColumns
+{
+    MappedColumns() : address(nullptr), length(0), values(nullptr), numSamples(0) {}
+
+    ~MappedColumns()
+    {
+#ifdef SPLINTER_MMAP
+        if (address != nullptr)
+            munmap(address, length);
+#endif // SPLINTER_MMAP
+    }
+
+    void *address;
+    size_t length;
+    std::vector<double> buffer;
+
+    std::vector<const double *> columns;
+    const double *values;
+    size_t numSamples;
+};
+
 DataTable::DataTable()
     : DataTable(false, false)
 {
@@ -33,8 +106,42 @@ DataTable::DataTable(bool allowDuplicates, bool allowIncompleteGrid)
     : allowDuplicates(allowDuplicates),
       allowIncompleteGrid(allowIncompleteGrid),
       numDuplicates(0),
-      numVariables(0)
+      numVariables(0),
+      numSorted(0),
+      sorted(true),
+      gridBuilt(false),
+      gridIndicesBuilt(false)
+{
+}
+
+DataTable::DataTable(const DataTable &other)
+    : DataTable()
+{
+    *this = other;
+}
+
+DataTable &DataTable::operator=(const DataTable &other)
 {
+    if (this == &other)
+        return *this;
+
+    std::lock_guard<std::recursive_mutex> lock(other.lazyMutex);
+
+    allowDuplicates = other.allowDuplicates;
+    allowIncompleteGrid = other.allowIncompleteGrid;
+    numDuplicates = other.numDuplicates;
+    numVariables = other.numVariables;
+    columns = other.columns;
+    values = other.values;
+    numSorted = other.numSorted;
+    mapped = other.mapped;
+    grid = other.grid;
+    gridIndices = other.gridIndices;
+    sorted = other.sorted.load();
+    gridBuilt = other.gridBuilt.load();
+    gridIndicesBuilt = other.gridIndicesBuilt.load();
+
+    return *this;
 }
 
 DataTable::DataTable(const char *fileName)
@@ -43,6 +150,7 @@ DataTable::DataTable(const char *fileName)
 }
 
 DataTable::DataTable(const std::string &fileName)
+    : DataTable()
 {
     load(fileName);
 }
@@ -62,9 +170,14 @@ void DataTable::addSample(DenseVector x, double y)
     addSample(DataPoint(x, y));
 }
 
+/*
+ * Appends the sample. Duplicates are discarded (or counted if allowDuplicates is true) when the table is sorted.
+ */
 void DataTable::addSample(const DataPoint &sample)
 {
-    if (getNumSamples() == 0)
+    materialize();
+
+    if (values.empty())
     {
         numVariables = sample.getDimX();
         initDataStructures();
@@ -74,45 +187,361 @@ void DataTable::addSample(const DataPoint &sample)
         throw Exception("Datatable::addSample: Dimension of new sample is inconsistent with previous samples!");
     }
 
-    // Check if the sample has been added already
-    if (samples.count(sample) > 0)
+    for (double x : sample.getX())
+        if (!std::isfinite(x))
+            throw Exception("Datatable::addSample: The sample point must be finite!");
+
+    for (unsigned int i = 0; i < numVariables; i++)
+        columns.at(i).push_back(sample.getX().at(i));
+    values.push_back(sample.getY());
+
+    sorted = false;
+    gridBuilt = false;
+    gridIndicesBuilt = false;
+}
+
+void DataTable::addSample(std::initializer_list<DataPoint> samples)
+{
+	for (auto& sample : samples)
+	{
+		addSample(sample);
+	}
+}
+
+void DataTable::addSamples(const double *X, const double *y, size_t numSamples, unsigned int numVariables, Layout layout)
+{
+    if (numSamples == 0)
+        return;
+
+    materialize();
+
+    if (values.empty())
+    {
+        if (numVariables == 0)
+            throw Exception("DataTable::addSamples: The samples must have at least one variable!");
+
+        this->numVariables = numVariables;
+        initDataStructures();
+    }
+
+    if (numVariables != this->numVariables)
+        throw Exception("DataTable::addSamples: Dimension of new samples is inconsistent with previous samples!");
+
+    // Checked before the table is changed
+    bool finite = true;
+    long long numValues = numSamples*numVariables;
+    #pragma omp parallel for schedule(static) reduction(&&:finite)
+    for (long long k = 0; k < numValues; k++)
+        finite = finite && std::isfinite(X[k]);
+
+    if (!finite)
+        throw Exception("DataTable::addSamples: The sample points must be finite!");
+
+    size_t offset = values.size();
+    values.insert(values.end(), y, y + numSamples);
+
+    for (unsigned int i = 0; i < numVariables; i++)
     {
-        if (!allowDuplicates)
+        std::vector<double> &column = columns.at(i);
+        column.resize(offset + numSamples);
+
+        if (layout == Layout::COLUMN_MAJOR)
+        {
+            std::copy(X + i*numSamples, X + (i + 1)*numSamples, column.begin() + offset);
+        }
+        else
         {
+            #pragma omp parallel for schedule(static)
+            for (long long j = 0; j < (long long)numSamples; j++)
+                column[offset + j] = X[j*numVariables + i];
+        }
+    }
+
+    sorted = false;
+    gridBuilt = false;
+    gridIndicesBuilt = false;
+}
+
+/*
+ * Stable sort of [first, last) in parallel (if OpenMP is enabled): the range is split in one chunk per thread,
+ * the chunks are sorted concurrently and then merged pairwise, in rounds where the merges run concurrently.
+ */
+template<class Iterator, class Compare>
+static void parallelStableSort(Iterator first, Iterator last, Compare less)
+{
+    long long size = last - first;
+    long long numChunks = 1;
+#ifdef _OPENMP
+    numChunks = std::max(1, omp_get_max_threads());
+#endif // _OPENMP
+
+    // Not worth splitting small ranges
+    const long long minChunkSize = 1 << 14;
+    numChunks = std::min(numChunks, std::max(1LL, size/minChunkSize));
+
+    std::vector<Iterator> bounds;
+    for (long long c = 0; c <= numChunks; ++c)
+        bounds.push_back(first + c*size/numChunks);
+
+    #pragma omp parallel for schedule(static)
+    for (long long c = 0; c < numChunks; ++c)
+        std::stable_sort(bounds[c], bounds[c + 1], less);
+
+    for (long long width = 1; width < numChunks; width *= 2)
+    {
+        #pragma omp parallel for schedule(dynamic)
+        for (long long c = 0; c < numChunks - width; c += 2*width)
+            std::inplace_merge(bounds[c], bounds[c + width], bounds[std::min(c + 2*width, numChunks)], less);
+    }
+}
+
+/*
+ * Sorts the samples appended since the last sort (stable, so equal samples keep their insertion order) and merges them
+ * into the sorted samples. A sample equal to its predecessor is a duplicate: it is discarded if allowDuplicates is false,
+ * as if it had never been added, and counted otherwise.
+ */
+void DataTable::sortSamples() const
+{
+    if (sorted)
+        return;
+
+    std::lock_guard<std::recursive_mutex> lock(lazyMutex);
+    if (sorted)
+        return;
+
+    size_t numSamples = getNumStored();
+    if (numSorted == numSamples)
+    {
+        sorted = true;
+        return;
+    }
+
+    auto less = [this](size_t a, size_t b)
+    {
+        for (const auto &column : columns)
+        {
+            if (column[a] < column[b])
+                return true;
+            else if (column[a] > column[b])
+                return false;
+        }
+        return false;
+    };
+
+    auto equal = [this](size_t a, size_t b)
+    {
+        for (const auto &column : columns)
+            if (column[a] != column[b])
+                return false;
+        return true;
+    };
+
+    std::vector<size_t> order(numSamples);
+    for (size_t j = 0; j < numSamples; ++j)
+        order[j] = j;
+
+    parallelStableSort(order.begin() + numSorted, order.end(), less);
+    std::inplace_merge(order.begin(), order.begin() + numSorted, order.end(), less);
+
+    // Remove (or count) duplicates
+    std::vector<size_t> kept;
+    kept.reserve(numSamples);
+    numDuplicates = 0;
+
+    for (size_t j : order)
+    {
+        if (!kept.empty() && equal(kept.back(), j))
+        {
+            if (!allowDuplicates)
+            {
 #ifndef NDEBUG
-            std::cout << "Discarding duplicate sample because allowDuplicates is false!" << std::endl;
-            std::cout << "Initialise with DataTable(true) to set it to true." << std::endl;
+                std::cout << "Discarding duplicate sample because allowDuplicates is false!" << std::endl;
+                std::cout << "Initialise with DataTable(true) to set it to true." << std::endl;
 #endif // NDEBUG
+                continue;
+            }
 
-            return;
+            numDuplicates++;
         }
 
-        numDuplicates++;
+        kept.push_back(j);
     }
 
-    samples.insert(sample);
+    // Permute the columns
+    long long numKept = kept.size();
+    std::vector<double> permuted(numKept);
+    for (unsigned int i = 0; i <= numVariables; i++)
+    {
+        std::vector<double> &column = (i < numVariables) ? columns.at(i) : values;
 
-    recordGridPoint(sample);
+        #pragma omp parallel for schedule(static)
+        for (long long k = 0; k < numKept; ++k)
+            permuted[k] = column[kept[k]];
+
+        column.swap(permuted);
+        permuted.resize(numKept);
+    }
+
+    numSorted = values.size();
+    sorted = true;
 }
 
-void DataTable::addSample(std::initializer_list<DataPoint> samples)
+void DataTable::buildGrid() const
 {
-	for (auto& sample : samples)
-	{
-		addSample(sample);
-	}
+    if (gridBuilt)
+        return;
+
+    std::lock_guard<std::recursive_mutex> lock(lazyMutex);
+    if (gridBuilt)
+        return;
+
+    sortSamples();
+
+    grid.assign(numVariables, std::vector<double>());
+
+    // The unique values are collected with a hash set (one lookup per sample), and only they are sorted
+    size_t numSamples = getNumStored();
+    for (unsigned int i = 0; i < numVariables; i++)
+    {
+        const double *column = getColumnData(i);
+        std::unordered_set<double> unique;
+        for (size_t j = 0; j < numSamples; j++)
+            unique.insert(column[j]);
+
+        grid.at(i).assign(unique.begin(), unique.end());
+        std::sort(grid.at(i).begin(), grid.at(i).end());
+    }
+
+    gridBuilt = true;
 }
 
-void DataTable::recordGridPoint(const DataPoint &sample)
+/*
+ * Maps the samples to grid indices with a hash map from grid value to index (one lookup per sample)
+ */
+void DataTable::buildGridIndices() const
 {
-    for (unsigned int i = 0; i < getNumVariables(); i++)
+    if (gridIndicesBuilt)
+        return;
+
+    std::lock_guard<std::recursive_mutex> lock(lazyMutex);
+    if (gridIndicesBuilt)
+        return;
+
+    buildGrid();
+
+    size_t numSamples = getNumStored();
+    gridIndices.assign(numVariables, std::vector<unsigned int>(numSamples));
+
+    for (unsigned int i = 0; i < numVariables; i++)
     {
-        grid.at(i).insert(sample.getX().at(i));
+        std::unordered_map<double, unsigned int> index;
+        index.reserve(grid.at(i).size());
+        for (unsigned int k = 0; k < grid.at(i).size(); k++)
+            index.emplace(grid.at(i).at(k), k);
+
+        const double *column = getColumnData(i);
+        std::vector<unsigned int> &indices = gridIndices.at(i);
+        for (size_t j = 0; j < numSamples; j++)
+        {
+            // Only values that do not equal themselves (NaN, e.g. from a loaded file) are not found
+            auto k = index.find(column[j]);
+            if (k == index.end())
+                throw Exception("DataTable::buildGridIndices: Sample " + std::to_string(j) + " has a value that is not finite.");
+            indices[j] = k->second;
+        }
     }
+
+    gridIndicesBuilt = true;
+}
+
+unsigned int DataTable::getNumSamples() const
+{
+    sortSamples();
+    return getNumStored();
+}
+
+DataPoint DataTable::getSample(size_t index) const
+{
+    if (index >= getNumSamples())
+        throw Exception("DataTable::getSample: Sample index out of range.");
+
+    std::vector<double> x(numVariables);
+    for (unsigned int i = 0; i < numVariables; i++)
+        x.at(i) = getColumnData(i)[index];
+
+    return DataPoint(x, getValueData()[index]);
+}
+
+std::multiset<DataPoint> DataTable::getSamples() const
+{
+    std::multiset<DataPoint> samples;
+    for (auto it = cbegin(); it != cend(); ++it)
+        samples.insert(samples.end(), *it);
+    return samples;
+}
+
+const double *DataTable::getColumnX(unsigned int variable) const
+{
+    if (variable >= numVariables)
+        throw Exception("DataTable::getColumnX: Invalid variable.");
+
+    sortSamples();
+    return getColumnData(variable);
+}
+
+const double *DataTable::getColumnY() const
+{
+    sortSamples();
+    return getValueData();
+}
+
+size_t DataTable::getNumStored() const
+{
+    return mapped ? mapped->numSamples : values.size();
+}
+
+const double *DataTable::getColumnData(unsigned int variable) const
+{
+    return mapped ? mapped->columns.at(variable) : columns.at(variable).data();
+}
+
+const double *DataTable::getValueData() const
+{
+    return mapped ? mapped->values : values.data();
+}
+
+void DataTable::materialize()
+{
+    if (!mapped)
+        return;
+
+    columns.assign(numVariables, std::vector<double>());
+    for (unsigned int i = 0; i < numVariables; i++)
+        columns.at(i).assign(mapped->columns.at(i), mapped->columns.at(i) + mapped->numSamples);
+    values.assign(mapped->values, mapped->values + mapped->numSamples);
+
+    mapped.reset();
+}
+
+const std::vector<std::vector<double>> &DataTable::getGrid() const
+{
+    buildGrid();
+    return grid;
+}
+
+const unsigned int *DataTable::getGridIndices(unsigned int variable) const
+{
+    if (variable >= numVariables)
+        throw Exception("DataTable::getGridIndices: Invalid variable.");
+
+    buildGridIndices();
+    return gridIndices.at(variable).data();
 }
 
 unsigned int DataTable::getNumSamplesRequired() const
 {
+    buildGrid();
+
     unsigned long samplesRequired = 1;
     unsigned int i = 0;
     for (auto &variable : grid)
@@ -126,15 +555,14 @@ unsigned int DataTable::getNumSamplesRequired() const
 
 bool DataTable::isGridComplete() const
 {
-    return samples.size() > 0 && samples.size() - numDuplicates == getNumSamplesRequired();
+    return getNumSamples() > 0 && getNumSamples() - numDuplicates == getNumSamplesRequired();
 }
 
 void DataTable::initDataStructures()
 {
-    for (unsigned int i = 0; i < getNumVariables(); i++)
-    {
-        grid.push_back(std::set<double>());
-    }
+    columns.resize(getNumVariables());
+    for (auto &column : columns)
+        column.clear();
 }
 
 void DataTable::gridCompleteGuard() const
@@ -152,66 +580,523 @@ void DataTable::save(const std::string &fileName) const
     s.saveToFile(fileName);
 }
 
+void DataTable::saveColumnar(const std::string &fileName) const
+{
+    sortSamples();
+
+    size_t numSamples = getNumStored();
+    uint64_t columnStride = (numSamples*sizeof(double) + columnarAlignment - 1)/columnarAlignment*columnarAlignment;
+
+    ColumnarHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, columnarMagic, sizeof(columnarMagic));
+    header.version = columnarVersion;
+    header.byteOrder = columnarByteOrder;
+    header.numVariables = numVariables;
+    header.flags = (allowDuplicates ? 1 : 0) | (allowIncompleteGrid ? 2 : 0);
+    header.numSamples = numSamples;
+    header.numDuplicates = numDuplicates;
+    header.columnStride = columnStride;
+
+    std::ofstream fs(fileName, std::ofstream::binary);
+    if (!fs.is_open())
+        throw Exception("DataTable::saveColumnar: Unable to open file \"" + fileName + "\" for writing.");
+
+    fs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    std::vector<char> padding(columnStride - numSamples*sizeof(double), 0);
+    for (unsigned int i = 0; i <= numVariables; i++)
+    {
+        const double *column = (i < numVariables) ? getColumnData(i) : getValueData();
+        fs.write(reinterpret_cast<const char *>(column), numSamples*sizeof(double));
+        fs.write(padding.data(), padding.size());
+    }
+
+    if (!fs)
+        throw Exception("DataTable::saveColumnar: Failed to write file \"" + fileName + "\".");
+}
+
 void DataTable::load(const std::string &fileName)
 {
+    // Columnar files are recognized by their magic number (a serialized table starts with a bool)
+    char magic[sizeof(columnarMagic)] = {0};
+    {
+        std::ifstream ifs(fileName, std::ifstream::binary);
+        ifs.read(magic, sizeof(magic));
+    }
+
+    if (std::memcmp(magic, columnarMagic, sizeof(columnarMagic)) == 0)
+    {
+        loadColumnar(fileName);
+        return;
+    }
+
     Serializer s(fileName);
     s.deserialize(*this);
 }
 
+void DataTable::loadColumnar(const std::string &fileName)
+{
+    auto file = std::make_shared<MappedColumns>();
+    const char *data = nullptr;
+    size_t length = 0;
+
+#ifdef SPLINTER_MMAP
+    int fd = open(fileName.c_str(), O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        throw Exception("DataTable::loadColumnar: Unable to open file \"" + fileName + "\".");
+    }
+
+    length = status.st_size;
+    if (length > 0)
+    {
+        void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED)
+        {
+            file->address = address;
+            file->length = length;
+            data = static_cast<const char *>(address);
+        }
+    }
+    close(fd);
+#endif // SPLINTER_MMAP
+
+    // Read the file if it could not be mapped
+    if (data == nullptr)
+    {
+        std::ifstream ifs(fileName, std::ifstream::binary | std::ifstream::ate);
+        if (!ifs.is_open())
+            throw Exception("DataTable::loadColumnar: Unable to open file \"" + fileName + "\".");
+
+        length = ifs.tellg();
+        file->buffer.resize((length + sizeof(double) - 1)/sizeof(double));
+        ifs.seekg(0, std::ifstream::beg);
+        ifs.read(reinterpret_cast<char *>(file->buffer.data()), length);
+        data = reinterpret_cast<const char *>(file->buffer.data());
+    }
+
+    ColumnarHeader header;
+    if (length < sizeof(header))
+        throw Exception("DataTable::loadColumnar: File is too small to be a columnar DataTable.");
+    std::memcpy(&header, data, sizeof(header));
+
+    if (header.byteOrder != columnarByteOrder)
+        throw Exception("DataTable::loadColumnar: File was written with a different byte order.");
+
+    if (header.version != columnarVersion)
+        throw Exception("DataTable::loadColumnar: Unsupported columnar format version " + std::to_string(header.version) + ".");
+
+    // The sizes are checked with divisions, so that the products cannot overflow for corrupt headers
+    uint64_t arrays = (uint64_t) header.numVariables + 1;
+    if (header.numSamples > std::numeric_limits<size_t>::max()/sizeof(double)
+        || header.columnStride < header.numSamples*sizeof(double)
+        || header.columnStride % columnarAlignment != 0
+        || header.columnStride > (length - sizeof(header))/arrays)
+        throw Exception("DataTable::loadColumnar: Corrupt columnar DataTable file.");
+
+    for (unsigned int i = 0; i < header.numVariables; i++)
+        file->columns.push_back(reinterpret_cast<const double *>(data + sizeof(header) + i*header.columnStride));
+    file->values = reinterpret_cast<const double *>(data + sizeof(header) + header.numVariables*header.columnStride);
+    file->numSamples = header.numSamples;
+
+    allowDuplicates = (header.flags & 1) != 0;
+    allowIncompleteGrid = (header.flags & 2) != 0;
+    numDuplicates = header.numDuplicates;
+    numVariables = header.numVariables;
+
+    columns.clear();
+    values.clear();
+    numSorted = header.numSamples;
+    sorted = true;
+    gridBuilt = false;
+    gridIndicesBuilt = false;
+    mapped = file;
+}
+
+DataTable DataTable::fromCsv(const std::string &fileName, const ImportOptions &options)
+{
+    ImportStatistics statistics;
+    return fromCsv(fileName, options, statistics);
+}
+
 /*
- * Getters for iterators
+ * strtod in the "C" locale, so that the decimal separator is '.' whatever the global locale is
+ * (where no locale-specific strtod is available, the global locale is used)
  */
-std::multiset<DataPoint>::const_iterator DataTable::cbegin() const
+static double parseDouble(const char *str, char **end)
 {
-    return samples.cbegin();
+#if defined(_MSC_VER)
+    static const _locale_t cLocale = _create_locale(LC_NUMERIC, "C");
+    return _strtod_l(str, end, cLocale);
+#elif defined(__unix__) || defined(__APPLE__)
+    static const locale_t cLocale = newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0);
+    return strtod_l(str, end, cLocale);
+#else
+    return std::strtod(str, end);
+#endif
 }
 
-std::multiset<DataPoint>::const_iterator DataTable::cend() const
+/*
+ * Parses the line [first, last) into numColumns values separated by delimiter (surrounding blanks are allowed).
+ * Returns false if the line has another format.
+ */
+static bool parseCsvLine(const char *first, const char *last, char delimiter, unsigned int numColumns, double *values)
 {
-    return samples.cend();
+    const char *p = first;
+    for (unsigned int c = 0; c < numColumns; ++c)
+    {
+        char *next;
+        values[c] = parseDouble(p, &next);
+        if (next == p || next > last)
+            return false;
+
+        p = next;
+        while (p < last && *p != delimiter && std::isspace((unsigned char) *p))
+            ++p;
+
+        if (c + 1 < numColumns)
+        {
+            if (p >= last || *p != delimiter)
+                return false;
+            ++p;
+        }
+    }
+
+    return p == last;
+}
+
+static bool isBlank(const char *first, const char *last)
+{
+    for (const char *p = first; p < last; ++p)
+        if (!std::isspace((unsigned char) *p))
+            return false;
+    return true;
 }
 
 /*
- * Get table of samples x-values,
- * i.e. table[i][j] is the value of variable i at sample j
+ * The file is read in blocks, and each block is parsed up to its last complete line (the rest is carried over
+ * to the next block). A block is split at line boundaries into one segment per thread; the segments are parsed
+ * into separate buffers, which are added in order. Apart from the table, the memory use is bounded by the block.
+ * The table is reserved after the first block, from the file size and the bytes per sample of that block.
  */
-std::vector< std::vector<double> > DataTable::getTableX() const
+DataTable DataTable::fromCsv(const std::string &fileName, const ImportOptions &options, ImportStatistics &statistics)
 {
-    gridCompleteGuard();
+    auto start = std::chrono::steady_clock::now();
+    statistics = ImportStatistics();
 
-    // Initialize table
-    std::vector<std::vector<double>> table;
-    for (unsigned int i = 0; i < numVariables; i++)
+    std::ifstream ifs(fileName, std::ifstream::binary | std::ifstream::ate);
+    if (!ifs.is_open())
+        throw Exception("DataTable::fromCsv: Unable to open file \"" + fileName + "\".");
+
+    // Unknown (0) if the file is not seekable
+    std::streamoff fileEnd = ifs.tellg();
+    size_t fileSize = (fileEnd > 0) ? fileEnd : 0;
+    if (fileEnd > 0)
+        ifs.seekg(0, std::ifstream::beg);
+    else
+        ifs.clear();
+
+    DataTable table(options.allowDuplicates, options.allowIncompleteGrid);
+
+    struct Segment
     {
-        std::vector<double> xi(getNumSamples(), 0.0);
-        table.push_back(xi);
+        size_t first, last;
+        std::vector<double> X, y;
+        size_t numLines, errorLine;
+    };
+
+    size_t blockSize = std::max(options.blockSize, (size_t) 1);
+    std::vector<char> block;
+    size_t carried = 0;     // Bytes of an incomplete line carried over from the previous block
+    size_t lineNumber = 0;  // Lines before the block
+    unsigned int numHeaderLines = options.numHeaderLines;
+    unsigned int numColumns = 0;
+
+    bool last = false;
+    while (!last)
+    {
+        block.resize(carried + blockSize + 1);
+        ifs.read(block.data() + carried, blockSize);
+        size_t numRead = ifs.gcount();
+        size_t size = carried + numRead;
+        block[size] = '\0'; // Stops parseDouble at the end of the data
+        statistics.numBytes += numRead;
+        last = (numRead < blockSize);
+
+        // Parse complete lines only (the last line of the file may lack a newline)
+        size_t end = size;
+        if (!last)
+        {
+            while (end > 0 && block[end - 1] != '\n')
+                --end;
+        }
+
+        size_t pos = 0;
+        while (numHeaderLines > 0 && pos < end)
+        {
+            const char *newline = static_cast<const char *>(std::memchr(block.data() + pos, '\n', end - pos));
+            pos = (newline != nullptr) ? newline - block.data() + 1 : end;
+            numHeaderLines--;
+            lineNumber++;
+        }
+
+        // The number of columns is given by the first sample
+        while (numColumns == 0 && pos < end)
+        {
+            const char *newline = static_cast<const char *>(std::memchr(block.data() + pos, '\n', end - pos));
+            size_t lineEnd = (newline != nullptr) ? newline - block.data() : end;
+
+            if (!isBlank(block.data() + pos, block.data() + lineEnd))
+            {
+                numColumns = 1 + std::count(block.data() + pos, block.data() + lineEnd, options.delimiter);
+                if (numColumns < 2)
+                    throw Exception("DataTable::fromCsv: Line " + std::to_string(lineNumber + 1) + " must have at least two values (x and y).");
+                break;
+            }
+
+            pos = (newline != nullptr) ? lineEnd + 1 : end;
+            lineNumber++;
+        }
+
+        int numSegments = 1;
+#ifdef _OPENMP
+        numSegments = std::max(1, omp_get_max_threads());
+#endif // _OPENMP
+
+        std::vector<Segment> segments(numSegments);
+        for (int s = 0; s < numSegments; ++s)
+        {
+            // Segments start after a newline
+            size_t first = (s == 0) ? pos : segments.at(s - 1).last;
+            size_t boundary = std::max(first, pos + (end - pos)*(s + 1)/numSegments);
+            while (boundary > first && boundary < end && block[boundary - 1] != '\n')
+                ++boundary;
+
+            segments.at(s).first = first;
+            segments.at(s).last = (s + 1 == numSegments) ? end : boundary;
+        }
+
+        #pragma omp parallel for schedule(static, 1)
+        for (int s = 0; s < numSegments; ++s)
+        {
+            Segment &segment = segments[s];
+            segment.numLines = 0;
+            segment.errorLine = std::numeric_limits<size_t>::max();
+
+            std::vector<double> row(numColumns);
+            const char *p = block.data() + segment.first;
+            const char *segmentEnd = block.data() + segment.last;
+
+            while (p < segmentEnd)
+            {
+                const char *newline = static_cast<const char *>(std::memchr(p, '\n', segmentEnd - p));
+                const char *lineEnd = (newline != nullptr) ? newline : segmentEnd;
+
+                if (!isBlank(p, lineEnd))
+                {
+                    if (!parseCsvLine(p, lineEnd, options.delimiter, numColumns, row.data()))
+                    {
+                        segment.errorLine = segment.numLines;
+                        break;
+                    }
+
+                    segment.X.insert(segment.X.end(), row.begin(), row.end() - 1);
+                    segment.y.push_back(row.back());
+                }
+
+                segment.numLines++;
+                p = lineEnd + 1;
+            }
+        }
+
+        // Reserve the table for the number of samples estimated from the first block and the file size
+        size_t numBlockSamples = 0;
+        for (auto &segment : segments)
+            numBlockSamples += segment.y.size();
+
+        size_t offset = statistics.numBytes - size + pos; // File offset of the samples of the block
+        if (table.values.empty() && numBlockSamples > 0 && fileSize > offset)
+        {
+            double bytesPerSample = (double) (end - pos)/numBlockSamples;
+            size_t estimate = (size_t) ((fileSize - offset)/bytesPerSample);
+            estimate += estimate/32;
+
+            table.numVariables = numColumns - 1;
+            table.initDataStructures();
+            for (auto &column : table.columns)
+                column.reserve(estimate);
+            table.values.reserve(estimate);
+        }
+
+        for (auto &segment : segments)
+        {
+            if (segment.errorLine != std::numeric_limits<size_t>::max())
+            {
+                throw Exception("DataTable::fromCsv: Line " + std::to_string(lineNumber + segment.errorLine + 1)
+                                + " does not have " + std::to_string(numColumns) + " values.");
+            }
+
+            table.addSamples(segment.X.data(), segment.y.data(), segment.y.size(), numColumns - 1, Layout::ROW_MAJOR);
+            statistics.numSamples += segment.y.size();
+            lineNumber += segment.numLines;
+        }
+
+        carried = size - end;
+        std::memmove(block.data(), block.data() + end, carried);
     }
 
-    // Fill table with values
-    int i = 0;
-    for (auto &sample : samples)
+    statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return table;
+}
+
+DataTable DataTable::fromRaw(const std::string &fileName, unsigned int numVariables, const ImportOptions &options)
+{
+    ImportStatistics statistics;
+    return fromRaw(fileName, numVariables, options, statistics);
+}
+
+/*
+ * The number of samples follows from the file size, so the table is allocated once. The records are read
+ * in blocks and split into x- and y-values in parallel.
+ */
+DataTable DataTable::fromRaw(const std::string &fileName, unsigned int numVariables, const ImportOptions &options, ImportStatistics &statistics)
+{
+    auto start = std::chrono::steady_clock::now();
+    statistics = ImportStatistics();
+
+    if (numVariables == 0)
+        throw Exception("DataTable::fromRaw: The samples must have at least one variable!");
+
+    std::ifstream ifs(fileName, std::ifstream::binary | std::ifstream::ate);
+    if (!ifs.is_open())
+        throw Exception("DataTable::fromRaw: Unable to open file \"" + fileName + "\".");
+
+    size_t size = ifs.tellg();
+    ifs.seekg(0, std::ifstream::beg);
+
+    size_t recordLength = numVariables + 1;
+    if (size % (recordLength*sizeof(double)) != 0)
+        throw Exception("DataTable::fromRaw: The file size is not a multiple of the record size.");
+
+    size_t numSamples = size/(recordLength*sizeof(double));
+
+    DataTable table(options.allowDuplicates, options.allowIncompleteGrid);
+    if (numSamples > 0)
+    {
+        table.numVariables = numVariables;
+        table.initDataStructures();
+        for (auto &column : table.columns)
+            column.reserve(numSamples);
+        table.values.reserve(numSamples);
+    }
+
+    long long blockLength = std::min(numSamples, std::max(options.blockSize/(recordLength*sizeof(double)), (size_t) 1));
+    std::vector<double> block(blockLength*recordLength);
+    std::vector<double> X(blockLength*numVariables);
+    std::vector<double> y(blockLength);
+
+    for (size_t done = 0; done < numSamples; done += blockLength)
     {
-        std::vector<double> x = sample.getX();
+        blockLength = std::min((size_t) blockLength, numSamples - done);
+        if (!ifs.read(reinterpret_cast<char *>(block.data()), blockLength*recordLength*sizeof(double)))
+            throw Exception("DataTable::fromRaw: Failed to read file \"" + fileName + "\".");
 
-        for (unsigned int j = 0; j < numVariables; j++)
+        #pragma omp parallel for schedule(static)
+        for (long long j = 0; j < blockLength; ++j)
         {
-            table.at(j).at(i) = x.at(j);
+            std::copy(&block[j*recordLength], &block[j*recordLength] + numVariables, &X[j*numVariables]);
+            y[j] = block[j*recordLength + numVariables];
         }
-        i++;
+
+        table.addSamples(X.data(), y.data(), blockLength, numVariables, Layout::ROW_MAJOR);
     }
 
+    statistics.numSamples = numSamples;
+    statistics.numBytes = size;
+    statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return table;
+}
+
+/*
+ * Getters for iterators
+ */
+DataTable::const_iterator DataTable::cbegin() const
+{
+    sortSamples();
+    return const_iterator(this, 0);
+}
+
+DataTable::const_iterator DataTable::cend() const
+{
+    return const_iterator(this, getNumSamples());
+}
+
+DataTable::const_iterator &DataTable::const_iterator::operator++()
+{
+    ++index;
+    return *this;
+}
+
+DataTable::const_iterator DataTable::const_iterator::operator++(int)
+{
+    const_iterator previous(*this);
+    ++*this;
+    return previous;
+}
+
+double DataTable::SampleRef::getX(unsigned int variable) const
+{
+    if (variable >= table->numVariables)
+        throw Exception("DataTable::SampleRef::getX: Invalid variable.");
+
+    return table->getColumnData(variable)[index];
+}
+
+std::vector<double> DataTable::SampleRef::getX() const
+{
+    std::vector<double> x(table->numVariables);
+    for (unsigned int i = 0; i < table->numVariables; i++)
+        x[i] = table->getColumnData(i)[index];
+    return x;
+}
+
+double DataTable::SampleRef::getY() const
+{
+    return table->getValueData()[index];
+}
+
+DataTable::SampleRef::operator DataPoint() const
+{
+    return DataPoint(getX(), getY());
+}
+
+/*
+ * Get table of samples x-values,
+ * i.e. table[i][j] is the value of variable i at sample j
+ */
+std::vector< std::vector<double> > DataTable::getTableX() const
+{
+    gridCompleteGuard();
+
+    size_t numSamples = getNumStored();
+    std::vector< std::vector<double> > table;
+    for (unsigned int i = 0; i < numVariables; i++)
+        table.push_back(std::vector<double>(getColumnData(i), getColumnData(i) + numSamples));
+
     return table;
 }
 
 // Get vector of y-values
 std::vector<double> DataTable::getVectorY() const
 {
-    std::vector<double> y;
-    for (std::multiset<DataPoint>::const_iterator it = cbegin(); it != cend(); ++it)
-    {
-        y.push_back(it->getY());
-    }
-    return y;
+    sortSamples();
+    return std::vector<double>(getValueData(), getValueData() + getNumStored());
 }
 
 DataTable operator+(const DataTable &lhs, const DataTable &rhs)
@@ -238,7 +1123,7 @@ DataTable operator-(const DataTable &lhs, const DataTable &rhs)
     }
 
     DataTable result;
-    auto rhsSamples = rhs.getSamples();
+    std::multiset<DataPoint> rhsSamples = rhs.getSamples();
     // Add all samples from lhs that are not in rhs
     for(auto it = lhs.cbegin(); it != lhs.cend(); it++) {
         if(rhsSamples.count(*it) == 0) {
@@ -0,0 +1,182 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <iterativesolvers.h>
+#include <cmath>
+
+namespace SPLINTER
+{
+
+/*
+ * LSQR by Paige and Saunders (1982), applied to the preconditioned operator A*R^-1.
+ * The Golub-Kahan bidiagonalization gives the estimate ||(A*R^-1)'*r|| = |phibar*alpha*c| of the residual.
+ */
+DenseVector solveLSQR(const LinearOperator &A, const DenseVector &b, const LinearOperator &preconditioner,
+                      double tolerance, unsigned int maxIterations, SolverStatistics &statistics)
+{
+    if (b.size() != A.rows)
+        throw Exception("solveLSQR: Incompatible size of right-hand side.");
+
+    statistics = SolverStatistics();
+
+    DenseVector y = DenseVector::Zero(A.cols);
+
+    DenseVector u = b;
+    double beta = u.norm();
+    if (beta == 0)
+        return y;
+    u /= beta;
+
+    DenseVector v = preconditioner.applyTranspose(A.applyTranspose(u));
+    double alpha = v.norm();
+    if (alpha == 0)
+        return y;
+    v /= alpha;
+
+    DenseVector w = v;
+    double phibar = beta;
+    double rhobar = alpha;
+    double normRhs = alpha*beta; // ||(A*R^-1)'*b||
+
+    statistics.converged = false;
+    statistics.relativeResidual = 1;
+
+    while (statistics.iterations < maxIterations)
+    {
+        statistics.iterations++;
+
+        // Continue the bidiagonalization
+        u = A.apply(preconditioner.apply(v)) - alpha*u;
+        beta = u.norm();
+        if (beta > 0)
+            u /= beta;
+
+        v = preconditioner.applyTranspose(A.applyTranspose(u)) - beta*v;
+        alpha = v.norm();
+        if (alpha > 0)
+            v /= alpha;
+
+        // Plane rotation eliminating the subdiagonal element beta
+        double rho = std::sqrt(rhobar*rhobar + beta*beta);
+        double c = rhobar/rho;
+        double s = beta/rho;
+        double theta = s*alpha;
+        rhobar = -c*alpha;
+        double phi = c*phibar;
+        phibar = s*phibar;
+
+        y += (phi/rho)*w;
+        w = v - (theta/rho)*w;
+
+        statistics.relativeResidual = std::abs(phibar*alpha*c)/normRhs;
+        if (statistics.relativeResidual <= tolerance || alpha == 0)
+        {
+            statistics.converged = true;
+            break;
+        }
+    }
+
+    return preconditioner.apply(y);
+}
+
+// Conjugate gradients on the normal equations of the preconditioned operator A*R^-1, without forming them
+DenseVector solveCGLS(const LinearOperator &A, const DenseVector &b, const LinearOperator &preconditioner,
+                      double tolerance, unsigned int maxIterations, SolverStatistics &statistics)
+{
+    if (b.size() != A.rows)
+        throw Exception("solveCGLS: Incompatible size of right-hand side.");
+
+    statistics = SolverStatistics();
+
+    DenseVector y = DenseVector::Zero(A.cols);
+    DenseVector r = b;
+    DenseVector s = preconditioner.applyTranspose(A.applyTranspose(r));
+    DenseVector p = s;
+
+    double gamma = s.squaredNorm();
+    double normRhs = std::sqrt(gamma);
+    if (normRhs == 0)
+        return y;
+
+    statistics.converged = false;
+    statistics.relativeResidual = 1;
+
+    while (statistics.iterations < maxIterations)
+    {
+        statistics.iterations++;
+
+        DenseVector q = A.apply(preconditioner.apply(p));
+        double step = gamma/q.squaredNorm();
+        y += step*p;
+        r -= step*q;
+
+        s = preconditioner.applyTranspose(A.applyTranspose(r));
+        double gammaNext = s.squaredNorm();
+
+        statistics.relativeResidual = std::sqrt(gammaNext)/normRhs;
+        if (statistics.relativeResidual <= tolerance)
+        {
+            statistics.converged = true;
+            break;
+        }
+
+        p = s + (gammaNext/gamma)*p;
+        gamma = gammaNext;
+    }
+
+    return preconditioner.apply(y);
+}
+
+DenseVector solveCG(const LinearOperator &A, const DenseVector &b, const LinearOperator &preconditioner, const DenseVector &x0,
+                    double tolerance, unsigned int maxIterations, SolverStatistics &statistics)
+{
+    if (A.rows != A.cols || b.size() != A.rows || x0.size() != A.cols)
+        throw Exception("solveCG: Incompatible dimensions.");
+
+    statistics = SolverStatistics();
+
+    DenseVector x = x0;
+    double normRhs = b.norm();
+    if (normRhs == 0)
+        return DenseVector::Zero(A.cols);
+
+    DenseVector r = b - A.apply(x);
+    statistics.relativeResidual = r.norm()/normRhs;
+    statistics.converged = statistics.relativeResidual <= tolerance;
+
+    DenseVector z = preconditioner.apply(r);
+    DenseVector p = z;
+    double rz = r.dot(z);
+
+    while (!statistics.converged && statistics.iterations < maxIterations)
+    {
+        statistics.iterations++;
+
+        DenseVector Ap = A.apply(p);
+        double step = rz/p.dot(Ap);
+        x += step*p;
+        r -= step*Ap;
+
+        statistics.relativeResidual = r.norm()/normRhs;
+        if (statistics.relativeResidual <= tolerance)
+        {
+            statistics.converged = true;
+            break;
+        }
+
+        z = preconditioner.apply(r);
+        double rzNext = r.dot(z);
+        p = z + (rzNext/rz)*p;
+        rz = rzNext;
+    }
+
+    return x;
+}
+
+} // namespace SPLINTER
@@ -0,0 +1,157 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <knotintervallocator.h>
+#include <algorithm>
+#include <cmath>
+
+namespace SPLINTER
+{
+
+KnotIntervalLocator::KnotIntervalLocator()
+    : uniform(false),
+      invSpacing(0)
+{
+}
+
+KnotIntervalLocator::KnotIntervalLocator(const std::vector<double> &knots)
+    : knots(knots),
+      uniform(false),
+      invSpacing(0)
+{
+    for (unsigned int i = 0; i < knots.size(); ++i)
+    {
+        if (distinct.empty() || distinct.back() != knots.at(i))
+        {
+            distinct.push_back(knots.at(i));
+            lastIndex.push_back(i);
+        }
+        else
+        {
+            lastIndex.back() = i;
+        }
+    }
+
+    // Check for uniformly spaced knot values
+    int numIntervals = (int)distinct.size() - 1;
+    if (numIntervals > 0)
+    {
+        double range = distinct.back() - distinct.front();
+        double spacing = range/numIntervals;
+
+        uniform = true;
+        for (int j = 1; j < numIntervals; ++j)
+        {
+            if (std::abs(distinct.at(j) - (distinct.front() + j*spacing)) > 1e-10*range)
+            {
+                uniform = false;
+                break;
+            }
+        }
+
+        invSpacing = 1.0/spacing;
+    }
+
+    // Eytzinger layout of the distinct knot values
+    eytzinger.resize(distinct.size() + 1);
+    eytzingerPosition.resize(distinct.size() + 1);
+    buildEytzinger(0, 1);
+}
+
+// Fills the subtree rooted at k with the sorted values starting at i, returns the next value to place
+int KnotIntervalLocator::buildEytzinger(int i, int k)
+{
+    if (k <= (int)distinct.size())
+    {
+        i = buildEytzinger(i, 2*k);
+        eytzinger.at(k) = distinct.at(i);
+        eytzingerPosition.at(k) = i;
+        i = buildEytzinger(i + 1, 2*k + 1);
+    }
+    return i;
+}
+
+int KnotIntervalLocator::find(double x) const
+{
+    return lastIndex[findDistinct(x)];
+}
+
+int KnotIntervalLocator::findFromHint(double x, int hint) const
+{
+    int n = knots.size();
+
+    if (hint < 0 || hint >= n - 1)
+        return find(x);
+
+    if (x < knots[hint])
+    {
+        // Gallop backwards to find the first knot that is larger than x
+        int hi = hint;
+        int step = 1;
+        while (hi - step >= 0 && x < knots[hi - step])
+        {
+            hi -= step;
+            step *= 2;
+        }
+        int lo = std::max(0, hi - step);
+        return std::upper_bound(knots.begin() + lo, knots.begin() + hi, x) - knots.begin() - 1;
+    }
+
+    if (x < knots[hint + 1])
+        return hint;
+
+    // Gallop forwards to find the first knot that is larger than x
+    int lo = hint + 1;
+    int step = 1;
+    while (lo + step < n && knots[lo + step] <= x)
+    {
+        lo += step;
+        step *= 2;
+    }
+    int hi = std::min(n, lo + step);
+    return std::upper_bound(knots.begin() + lo, knots.begin() + hi, x) - knots.begin() - 1;
+}
+
+// Returns the index j of the last distinct knot value with distinct[j] <= x
+int KnotIntervalLocator::findDistinct(double x) const
+{
+    int n = distinct.size();
+
+    if (uniform)
+    {
+        int j = (int)((x - distinct.front())*invSpacing);
+        j = std::max(0, std::min(j, n - 1));
+
+        // Correct for rounding errors
+        while (j + 1 < n && distinct[j + 1] <= x)
+            ++j;
+        while (j > 0 && x < distinct[j])
+            --j;
+
+        return j;
+    }
+
+    // Branch-free descent, k ends at the position of the first value larger than x (or 0 if there is none)
+    int k = 1;
+    while (k <= n)
+        k = 2*k + (eytzinger[k] <= x);
+
+    // Strip the trailing right turns and the final left turn
+#if defined(__GNUC__)
+    k >>= __builtin_ffs(~k);
+#else
+    while (k & 1)
+        k >>= 1;
+    k >>= 1;
+#endif
+
+    return (k == 0 ? n : eytzingerPosition[k]) - 1;
+}
+
+} // namespace SPLINTER
@@ -13,84 +13,72 @@
 namespace SPLINTER
 {
 
-/* 
- * Implementation of Kronecker product. 
+/*
+ * Implementation of Kronecker product.
  * Eigen has an implementation of the Kronecker product,
  * but it is very slow due to poor memory reservation.
  * See: https://forum.kde.org/viewtopic.php?f=74&t=106955&p=309990&hilit=kronecker#p309990
- * When Eigen update their implementation, and officially support it, we switch to that.
+ *
+ * The product is constructed directly in compressed (CSC) storage. Column jA*cols(B) + jB of A x B holds
+ * nnz(A(:,jA))*nnz(B(:,jB)) entries, so the outer index of the product is known in closed form,
+ * outer(jA*cols(B) + jB) = outerA(jA)*nnz(B) + nnz(A(:,jA))*outerB(jB),
+ * and the columns are filled independently (in parallel if OpenMP is enabled), with sorted row indices.
  */
 SparseMatrix myKroneckerProduct(const SparseMatrix &A, const SparseMatrix &B)
 {
-    SparseMatrix AB(A.rows()*B.rows(), A.cols()*B.cols());
+    // Non-zero tolerance: compressed copies without (numerically) zero entries
+    double tolerance = std::numeric_limits<SparseMatrix::Scalar>::epsilon();
+    SparseMatrix Ac = A;
+    SparseMatrix Bc = B;
+    Ac.prune(1.0, tolerance);
+    Bc.prune(1.0, tolerance);
 
-    // Reserve memory for AB
+    int rowsB = Bc.rows();
+    int colsB = Bc.cols();
+    int nnzB = Bc.nonZeros();
 
-    //AB.reserve(A.nonZeros()*B.nonZeros()); // Does not reserve inner vectors (slow)
-    //int innernnz = std::ceil(A.nonZeros()*B.nonZeros()/AB.outerSize());
-    //AB.reserve(Eigen::VectorXi::Constant(AB.outerSize(), innernnz)); // Assumes equal distribution of non-zeros (slow)
+    const int *outerA = Ac.outerIndexPtr();
+    const int *innerA = Ac.innerIndexPtr();
+    const double *valuesA = Ac.valuePtr();
+    const int *outerB = Bc.outerIndexPtr();
+    const int *innerB = Bc.innerIndexPtr();
+    const double *valuesB = Bc.valuePtr();
 
-    // Calculate exact number of non-zeros for each inner vector
-    Eigen::VectorXi nnzA = Eigen::VectorXi::Zero(A.outerSize());
-    Eigen::VectorXi nnzB = Eigen::VectorXi::Zero(B.outerSize());
-    Eigen::VectorXi nnzAB = Eigen::VectorXi::Zero(AB.outerSize());
-    //innerNonZeros.setZero();
+    SparseMatrix AB(Ac.rows()*rowsB, Ac.cols()*colsB);
+    AB.resizeNonZeros(Ac.nonZeros()*nnzB);
 
-    for (int jA = 0; jA < A.outerSize(); ++jA)
-    {
-        int nnz = 0;
-        for (SparseMatrix::InnerIterator itA(A,jA); itA; ++itA) nnz++;
-        nnzA(jA) = nnz;
-    }
+    int *outer = AB.outerIndexPtr();
+    int *inner = AB.innerIndexPtr();
+    double *values = AB.valuePtr();
 
-    for (int jB = 0; jB < B.outerSize(); ++jB)
+    for (int jA = 0; jA < Ac.cols(); ++jA)
     {
-        int nnz = 0;
-        for (SparseMatrix::InnerIterator itB(B,jB); itB; ++itB) nnz++;
-        nnzB(jB) = nnz;
+        int nnzColA = outerA[jA + 1] - outerA[jA];
+        for (int jB = 0; jB < colsB; ++jB)
+            outer[jA*colsB + jB] = outerA[jA]*nnzB + nnzColA*outerB[jB];
     }
+    outer[AB.cols()] = AB.nonZeros();
 
-    int innz = 0;
-    for (int i = 0; i < nnzA.rows(); ++i)
+    #pragma omp parallel for schedule(static)
+    for (int j = 0; j < AB.cols(); ++j)
     {
-        for (int j = 0; j < nnzB.rows(); ++j)
-        {
-            nnzAB(innz) = nnzA(i)*nnzB(j);
-            innz++;
-        }
-    }
-
-    AB.reserve(nnzAB);
+        int jA = j/colsB;
+        int jB = j%colsB;
+        int k = outer[j];
 
-    // Non-zero tolerance
-    double tolerance = std::numeric_limits<SparseMatrix::Scalar>::epsilon();
-
-    // Compute Kronecker product
-    for (int jA = 0; jA < A.outerSize(); ++jA)
-    {
-        for (SparseMatrix::InnerIterator itA(A,jA); itA; ++itA)
+        for (int kA = outerA[jA]; kA < outerA[jA + 1]; ++kA)
         {
-            if (std::abs(itA.value()) > tolerance)
+            int rowOffset = innerA[kA]*rowsB;
+            double valueA = valuesA[kA];
+
+            for (int kB = outerB[jB]; kB < outerB[jB + 1]; ++kB, ++k)
             {
-                int jrow = itA.row()*B.rows();
-                int jcol = itA.col()*B.cols();
-
-                for (int jB = 0; jB < B.outerSize(); ++jB)
-                {
-                    for (SparseMatrix::InnerIterator itB(B,jB); itB; ++itB)
-                    {
-                        if (std::abs(itA.value()*itB.value()) > tolerance)
-                        {
-                            int row = jrow + itB.row();
-                            int col = jcol + itB.col();
-                            AB.insert(row,col) = itA.value()*itB.value();
-                        }
-                    }
-                }
+                inner[k] = rowOffset + innerB[kB];
+                values[k] = valueA*valuesB[kB];
             }
         }
     }
-    AB.makeCompressed();
+
     return AB;
 }
 
@@ -172,4 +160,182 @@ SparseMatrix kroneckerProductMatrices(const std::vector<SparseMatrix> &matrices)
     return temp1;
 }
 
+/*
+ * Applies the factor matrices (dense or sparse) along their modes of x, which is viewed as a tensor with dimensions dims.
+ * Factors flagged in skip (identity matrices) are not applied.
+ */
+template<class Factor>
+static DenseVector applyModeProducts(const std::vector<Factor> &factors, std::vector<int> dims, DenseVector x,
+                                     const std::vector<bool> &skip = std::vector<bool>())
+{
+    for (unsigned int mode = 0; mode < factors.size(); ++mode)
+    {
+        if (mode < skip.size() && skip.at(mode))
+            continue;
+
+        x = kroneckerModeProduct(factors.at(mode), mode, dims, x);
+        dims.at(mode) = factors.at(mode).rows();
+    }
+
+    return x;
+}
+
+/*
+ * Applies the factors to all columns of X at once. The columns of X are stored as an additional (fastest varying)
+ * mode that no factor is applied to, so that each mode product multiplies A with slabs that are X.cols() times wider.
+ */
+template<class Factor>
+static DenseMatrix applyModeProducts(const std::vector<Factor> &factors, const DenseMatrix &X,
+                                     const std::vector<bool> &skip = std::vector<bool>())
+{
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrix;
+
+    std::vector<int> dims;
+    int numRows = 1;
+    for (const auto &factor : factors)
+    {
+        dims.push_back(factor.cols());
+        numRows *= factor.rows();
+    }
+    dims.push_back(X.cols());
+
+    RowMajorMatrix Xr = X;
+    DenseVector result = applyModeProducts(factors, dims, Eigen::Map<const DenseVector>(Xr.data(), Xr.size()), skip);
+
+    return Eigen::Map<const RowMajorMatrix>(result.data(), numRows, X.cols());
+}
+
+DenseVector kroneckerProductApply(const std::vector<DenseMatrix> &factors, const DenseVector &x)
+{
+    std::vector<int> dims;
+    for (const auto &factor : factors)
+        dims.push_back(factor.cols());
+
+    return applyModeProducts(factors, dims, x);
+}
+
+DenseMatrix kroneckerProductApply(const std::vector<DenseMatrix> &factors, const DenseMatrix &X)
+{
+    return applyModeProducts(factors, X);
+}
+
+
+// Each slab of the tensor is a cols(A) x right (row-major) matrix that is multiplied by A
+template<class Matrix>
+static DenseVector modeProduct(const Matrix &A, unsigned int mode, const std::vector<int> &dims, const DenseVector &x)
+{
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrix;
+
+    if (mode >= dims.size() || A.cols() != dims.at(mode))
+        throw Exception("kroneckerModeProduct: Incompatible matrix dimensions.");
+
+    int left = 1;
+    int right = 1;
+    for (unsigned int i = 0; i < dims.size(); ++i)
+    {
+        if (i < mode)
+            left *= dims.at(i);
+        else if (i > mode)
+            right *= dims.at(i);
+    }
+
+    if (x.size() != left*A.cols()*right)
+        throw Exception("kroneckerModeProduct: Incompatible size of vector.");
+
+    DenseVector y(left*A.rows()*right);
+
+    #pragma omp parallel for schedule(static) if (left > 1)
+    for (int l = 0; l < left; ++l)
+    {
+        Eigen::Map<const RowMajorMatrix> in(x.data() + l*A.cols()*right, A.cols(), right);
+        Eigen::Map<RowMajorMatrix> out(y.data() + l*A.rows()*right, A.rows(), right);
+        out.noalias() = A*in;
+    }
+
+    return y;
+}
+
+DenseVector kroneckerModeProduct(const DenseMatrix &A, unsigned int mode, const std::vector<int> &dims, const DenseVector &x)
+{
+    return modeProduct(A, mode, dims, x);
+}
+
+DenseVector kroneckerModeProduct(const SparseMatrix &A, unsigned int mode, const std::vector<int> &dims, const DenseVector &x)
+{
+    return modeProduct(A, mode, dims, x);
+}
+
+static bool isIdentity(const SparseMatrix &A)
+{
+    if (A.rows() != A.cols())
+        return false;
+
+    int numOnes = 0;
+    for (int j = 0; j < A.outerSize(); ++j)
+    {
+        for (SparseMatrix::InnerIterator it(A, j); it; ++it)
+        {
+            if (it.value() != 0 && (it.row() != it.col() || it.value() != 1))
+                return false;
+            if (it.value() == 1)
+                ++numOnes;
+        }
+    }
+
+    return numOnes == A.rows();
+}
+
+KroneckerOperator::KroneckerOperator(const std::vector<SparseMatrix> &factors)
+    : factors(factors)
+{
+    if (factors.empty())
+        throw Exception("KroneckerOperator::KroneckerOperator: At least one factor is required.");
+
+    for (auto &factor : this->factors)
+    {
+        factor.makeCompressed();
+        identity.push_back(isIdentity(factor));
+    }
+}
+
+int KroneckerOperator::rows() const
+{
+    int rows = 1;
+    for (const auto &factor : factors)
+        rows *= factor.rows();
+    return rows;
+}
+
+int KroneckerOperator::cols() const
+{
+    int cols = 1;
+    for (const auto &factor : factors)
+        cols *= factor.cols();
+    return cols;
+}
+
+KroneckerOperator KroneckerOperator::transpose() const
+{
+    std::vector<SparseMatrix> transposed;
+    for (const auto &factor : factors)
+        transposed.push_back(factor.transpose());
+    return KroneckerOperator(transposed);
+}
+
+DenseMatrix KroneckerOperator::operator*(const DenseMatrix &X) const
+{
+    if (X.rows() != cols())
+        throw Exception("KroneckerOperator::operator*: Incompatible matrix dimensions.");
+
+    return applyModeProducts(factors, X, identity);
+}
+
+SparseMatrix KroneckerOperator::toSparse() const
+{
+    SparseMatrix A = factors.front();
+    for (unsigned int i = 1; i < factors.size(); ++i)
+        A = myKroneckerProduct(A, factors.at(i));
+    return A;
+}
+
 } // namespace SPLINTER
@@ -13,12 +13,41 @@
 #include "datapoint.h"
 #include <datatable.h>
 #include <bspline.h>
+#include <vectorbspline.h>
 #include <bsplinebasis.h>
 #include <bsplinebasis1d.h>
 
 namespace SPLINTER
 {
 
+// Format tags: "SPBS" and version 2 (without knot averages) for BSpline
+static const uint32_t BSPLINE_FORMAT_MAGIC = 0x53425053;
+static const uint32_t BSPLINE_FORMAT_VERSION = 2;
+
+// Format tags: "SPDT" and version 2 (columnar samples) for DataTable
+static const uint32_t DATATABLE_FORMAT_MAGIC = 0x54445053;
+static const uint32_t DATATABLE_FORMAT_VERSION = 2;
+
+// Format tags: "SPVB" and version 1 for VectorBSpline (always tagged)
+static const uint32_t VECTORBSPLINE_FORMAT_MAGIC = 0x42565053;
+static const uint32_t VECTORBSPLINE_FORMAT_VERSION = 1;
+
+// Name of the type with the given format magic, or nullptr if the magic is unknown
+static const char *formatTypeName(uint32_t magic)
+{
+    switch (magic)
+    {
+    case BSPLINE_FORMAT_MAGIC:
+        return "BSpline";
+    case DATATABLE_FORMAT_MAGIC:
+        return "DataTable";
+    case VECTORBSPLINE_FORMAT_MAGIC:
+        return "VectorBSpline";
+    default:
+        return nullptr;
+    }
+}
+
 Serializer::Serializer()
 {
     stream = StreamType(0);
@@ -71,6 +100,53 @@ void Serializer::loadFromFile(const std::string &fileName)
     read = stream.cbegin();
 }
 
+size_t Serializer::get_format_tag_size()
+{
+    return 2*sizeof(uint32_t);
+}
+
+void Serializer::_serialize_format_tag(uint32_t magic, uint32_t version)
+{
+    _serialize(magic);
+    _serialize(version);
+}
+
+uint32_t Serializer::deserialize_format_tag(uint32_t magic, uint32_t currentVersion, const std::string &typeName,
+                                            bool untaggedVersion1)
+{
+    uint32_t streamMagic = 0;
+    if (stream.cend() - read >= (long) get_format_tag_size())
+        std::copy(read, read + sizeof(streamMagic), reinterpret_cast<uint8_t *>(&streamMagic));
+
+    if (streamMagic != magic)
+    {
+        const char *streamTypeName = formatTypeName(streamMagic);
+        if (streamTypeName != nullptr)
+            throw Exception("Serializer::deserialize: Expected a " + typeName + ", but found a " + streamTypeName + ".");
+
+        if (!untaggedVersion1)
+            throw Exception("Serializer::deserialize: The data is not a " + typeName + " (no format tag).");
+
+        // Untagged (original) layout
+        return 1;
+    }
+
+    uint32_t version;
+    deserialize(streamMagic);
+    deserialize(version);
+
+    // Tagged versions start at 2 for the types that have an untagged version 1
+    uint32_t firstTaggedVersion = untaggedVersion1 ? 2 : 1;
+    if (version < firstTaggedVersion || version > currentVersion)
+    {
+        throw Exception("Serializer::deserialize: " + typeName + " was saved in format version " + std::to_string(version)
+                        + ", which is not supported by this version of SPLINTER (versions 1 to "
+                        + std::to_string(currentVersion) + ").");
+    }
+
+    return version;
+}
+
 /*
  * get_size implementations
  */
@@ -82,18 +158,31 @@ size_t Serializer::get_size(const DataPoint &obj)
 
 size_t Serializer::get_size(const DataTable &obj)
 {
-    return get_size(obj.allowDuplicates)
+    // The samples are serialized sorted (and without discarded duplicates), from the columns or the mapped file
+    obj.sortSamples();
+    size_t columnSize = sizeof(size_t) + obj.getNumStored()*sizeof(double);
+
+    return get_format_tag_size()
+           + get_size(obj.allowDuplicates)
            + get_size(obj.allowIncompleteGrid)
            + get_size(obj.numDuplicates)
            + get_size(obj.numVariables)
-           + get_size(obj.samples)
-           + get_size(obj.grid);
+           + sizeof(size_t) + obj.numVariables*columnSize
+           + columnSize;
 }
 
 size_t Serializer::get_size(const BSpline &obj)
 {
-    return get_size(obj.basis)
-           + get_size(obj.knotaverages)
+    return get_format_tag_size()
+           + get_size(obj.basis)
+           + get_size(obj.coefficients)
+           + get_size(obj.numVariables);
+}
+
+size_t Serializer::get_size(const VectorBSpline &obj)
+{
+    return get_format_tag_size()
+           + get_size(obj.basis)
            + get_size(obj.coefficients)
            + get_size(obj.numVariables);
 }
@@ -156,18 +245,39 @@ void Serializer::_serialize(const DataPoint &obj)
 
 void Serializer::_serialize(const DataTable &obj)
 {
+    _serialize_format_tag(DATATABLE_FORMAT_MAGIC, DATATABLE_FORMAT_VERSION);
     _serialize(obj.allowDuplicates);
     _serialize(obj.allowIncompleteGrid);
     _serialize(obj.numDuplicates);
     _serialize(obj.numVariables);
-    _serialize(obj.samples);
-    _serialize(obj.grid);
+
+    // Written in the layout of the vectors columns and values
+    size_t numSamples = obj.getNumStored();
+    _serialize((size_t) obj.numVariables);
+    for (unsigned int i = 0; i < obj.numVariables; i++)
+        _serialize_array(obj.getColumnData(i), numSamples);
+    _serialize_array(obj.getValueData(), numSamples);
+}
+
+void Serializer::_serialize_array(const double *data, size_t size)
+{
+    _serialize(size);
+    auto bytes = reinterpret_cast<const uint8_t *>(data);
+    write = std::copy(bytes, bytes + size*sizeof(double), write);
 }
 
 void Serializer::_serialize(const BSpline &obj)
 {
+    _serialize_format_tag(BSPLINE_FORMAT_MAGIC, BSPLINE_FORMAT_VERSION);
+    _serialize(obj.basis);
+    _serialize(obj.coefficients);
+    _serialize(obj.numVariables);
+}
+
+void Serializer::_serialize(const VectorBSpline &obj)
+{
+    _serialize_format_tag(VECTORBSPLINE_FORMAT_MAGIC, VECTORBSPLINE_FORMAT_VERSION);
     _serialize(obj.basis);
-    _serialize(obj.knotaverages);
     _serialize(obj.coefficients);
     _serialize(obj.numVariables);
 }
@@ -232,18 +342,74 @@ void Serializer::deserialize(DataPoint &obj)
 
 void Serializer::deserialize(DataTable &obj)
 {
+    uint32_t version = deserialize_format_tag(DATATABLE_FORMAT_MAGIC, DATATABLE_FORMAT_VERSION, "DataTable");
+
     deserialize(obj.allowDuplicates);
     deserialize(obj.allowIncompleteGrid);
     deserialize(obj.numDuplicates);
     deserialize(obj.numVariables);
-    deserialize(obj.samples);
-    deserialize(obj.grid);
+
+    obj.mapped.reset();
+
+    if (version == 1)
+    {
+        // Version 1 stored the samples as a multiset of DataPoints, followed by the grid (rebuilt on demand)
+        std::multiset<DataPoint> samples;
+        std::vector<std::set<double>> grid;
+        deserialize(samples);
+        deserialize(grid);
+
+        obj.columns.assign(obj.numVariables, std::vector<double>());
+        obj.values.clear();
+        for (const auto &sample : samples)
+        {
+            for (unsigned int i = 0; i < obj.numVariables; i++)
+                obj.columns.at(i).push_back(sample.getX().at(i));
+            obj.values.push_back(sample.getY());
+        }
+
+        // Sorted (and duplicates counted) on first access
+        obj.numSorted = 0;
+        obj.sorted = obj.values.empty();
+    }
+    else
+    {
+        deserialize(obj.columns);
+        deserialize(obj.values);
+
+        obj.numSorted = obj.values.size();
+        obj.sorted = true;
+    }
+
+    obj.gridBuilt = false;
+    obj.gridIndicesBuilt = false;
 }
 
 void Serializer::deserialize(BSpline &obj)
 {
+    uint32_t version = deserialize_format_tag(BSPLINE_FORMAT_MAGIC, BSPLINE_FORMAT_VERSION, "BSpline");
+
+    deserialize(obj.basis);
+
+    // Version 1 stored the knot averages (as a matrix) before the coefficients
+    if (version == 1)
+    {
+        DenseMatrix knotaverages;
+        deserialize(knotaverages);
+    }
+
+    deserialize(obj.coefficients);
+    deserialize(obj.numVariables);
+
+    // The knot averages are not stored, since they follow from the knot vectors
+    obj.knotaverages = obj.computeKnotAverages();
+}
+
+void Serializer::deserialize(VectorBSpline &obj)
+{
+    deserialize_format_tag(VECTORBSPLINE_FORMAT_MAGIC, VECTORBSPLINE_FORMAT_VERSION, "VectorBSpline", false);
+
     deserialize(obj.basis);
-    deserialize(obj.knotaverages);
     deserialize(obj.coefficients);
     deserialize(obj.numVariables);
 }
@@ -259,6 +425,8 @@ void Serializer::deserialize(BSplineBasis1D &obj)
     deserialize(obj.degree);
     deserialize(obj.knots);
     deserialize(obj.targetNumBasisfunctions);
+    obj.locator = KnotIntervalLocator(obj.knots);
+    obj.kernel = getBasisKernel(obj.degree);
 }
 
 void Serializer::deserialize(DenseMatrix &obj)
@@ -0,0 +1,288 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "vectorbspline.h"
+#include <serializer.h>
+#include "bsplinebasiskernel.h"
+#include <algorithm>
+
+namespace SPLINTER
+{
+
+VectorBSpline::VectorBSpline()
+    : numVariables(0)
+{}
+
+VectorBSpline::VectorBSpline(const DenseMatrix &coefficients, std::vector<std::vector<double>> knotVectors, std::vector<unsigned int> basisDegrees)
+    : basis(BSplineBasis(knotVectors, basisDegrees)),
+      numVariables(knotVectors.size())
+{
+    setCoefficients(coefficients);
+}
+
+VectorBSpline::VectorBSpline(const std::vector<BSpline> &bsplines)
+    : numVariables(0)
+{
+    if (bsplines.empty())
+        throw Exception("VectorBSpline::VectorBSpline: At least one B-spline is required.");
+
+    auto knotVectors = bsplines.front().getKnotVectors();
+    auto basisDegrees = bsplines.front().getBasisDegrees();
+
+    basis = BSplineBasis(knotVectors, basisDegrees);
+    numVariables = knotVectors.size();
+    coefficients.resize(bsplines.size(), basis.getNumBasisFunctions());
+
+    for (unsigned int i = 0; i < bsplines.size(); ++i)
+    {
+        if (bsplines.at(i).getKnotVectors() != knotVectors || bsplines.at(i).getBasisDegrees() != basisDegrees)
+            throw Exception("VectorBSpline::VectorBSpline: The B-splines must have the same knot vectors and basis degrees.");
+
+        coefficients.row(i) = bsplines.at(i).getCoefficients().transpose();
+    }
+}
+
+/*
+ * Construct from saved data
+ */
+VectorBSpline::VectorBSpline(const char *fileName)
+    : VectorBSpline(std::string(fileName))
+{
+}
+
+VectorBSpline::VectorBSpline(const std::string &fileName)
+    : numVariables(0)
+{
+    load(fileName);
+}
+
+DenseVector VectorBSpline::eval(const DenseVector &x) const
+{
+    if (x.size() != numVariables)
+        throw Exception("VectorBSpline::eval: Wrong dimension on evaluation point x.");
+
+    #ifndef NDEBUG
+    if (!pointInDomain(x.data()))
+        throw Exception("VectorBSpline::eval: Evaluation at point outside domain.");
+    #endif // NDEBUG
+
+    DenseVector values(getNumOutputs());
+    evalSupported(x.data(), values.data(), nullptr);
+    return values;
+}
+
+DenseMatrix VectorBSpline::evalJacobian(const DenseVector &x) const
+{
+    if (x.size() != numVariables)
+        throw Exception("VectorBSpline::evalJacobian: Wrong dimension on evaluation point x.");
+
+    #ifndef NDEBUG
+    if (!pointInDomain(x.data()))
+        throw Exception("VectorBSpline::evalJacobian: Evaluation at point outside domain.");
+    #endif // NDEBUG
+
+    DenseVector values(getNumOutputs());
+    DenseMatrix jacobian(getNumOutputs(), numVariables);
+    evalSupported(x.data(), values.data(), jacobian.data());
+    return jacobian;
+}
+
+void VectorBSpline::eval(const double *x, double *values) const
+{
+    #ifndef NDEBUG
+    if (!pointInDomain(x))
+        throw Exception("VectorBSpline::eval: Evaluation at point outside domain.");
+    #endif // NDEBUG
+
+    evalSupported(x, values, nullptr);
+}
+
+/*
+ * The values are computed along with the Jacobian in a stack buffer (heap only for many outputs)
+ */
+void VectorBSpline::evalJacobian(const double *x, double *jacobian) const
+{
+    #ifndef NDEBUG
+    if (!pointInDomain(x))
+        throw Exception("VectorBSpline::evalJacobian: Evaluation at point outside domain.");
+    #endif // NDEBUG
+
+    const unsigned int maxStackOutputs = 64;
+    double buffer[maxStackOutputs];
+    std::vector<double> heapBuffer;
+    double *values = buffer;
+
+    if (getNumOutputs() > maxStackOutputs)
+    {
+        heapBuffer.resize(getNumOutputs());
+        values = heapBuffer.data();
+    }
+
+    evalSupported(x, values, jacobian);
+}
+
+bool VectorBSpline::pointInDomain(const double *x) const
+{
+    DenseVector point = Eigen::Map<const DenseVector>(x, numVariables);
+    return basis.insideSupport(point);
+}
+
+/*
+ * The supported tensor-product basis functions are visited with an odometer over the supported basis functions of each
+ * variable (the last variable fastest), and each adds its weight times its (contiguous) column of coefficients.
+ * The weights are products of the univariate values; for the partial derivative with respect to variable i, factor i
+ * is replaced by its derivative, using the prefix and suffix products of the factors.
+ * Only stack storage is used, as in BSplineBasis::evalContracted, unless the degrees are high.
+ */
+void VectorBSpline::evalSupported(const double *x, double *values, double *jacobian) const
+{
+    unsigned int numOutputs = getNumOutputs();
+    std::fill(values, values + numOutputs, 0.0);
+    if (jacobian != nullptr)
+        std::fill(jacobian, jacobian + numOutputs*numVariables, 0.0);
+
+    if (numVariables > MAX_CONTRACTION_VARIABLES)
+        throw Exception("VectorBSpline::evalSupported: Too many variables.");
+
+    unsigned int order = (jacobian != nullptr) ? 1 : 0;
+
+    double buffer[2*MAX_CONTRACTION_VARIABLES*(MAX_KERNEL_DEGREE + 1)];
+    std::vector<double> heapBuffer;
+    double *univariate = buffer;
+
+    unsigned int numSupported = basis.getNumSupportedValues();
+    if (numSupported > MAX_CONTRACTION_VARIABLES*(MAX_KERNEL_DEGREE + 1))
+    {
+        heapBuffer.resize((order + 1)*numSupported);
+        univariate = heapBuffer.data();
+    }
+
+    unsigned int first[MAX_CONTRACTION_VARIABLES];
+    if (!basis.evalSupportedDerivatives(x, order, univariate, first))
+        return;
+
+    const double *factors[MAX_CONTRACTION_VARIABLES];
+    const double *derivatives[MAX_CONTRACTION_VARIABLES];
+    unsigned int numSupportedDim[MAX_CONTRACTION_VARIABLES];
+    unsigned int counter[MAX_CONTRACTION_VARIABLES];
+    size_t stride[MAX_CONTRACTION_VARIABLES];
+    double prefix[MAX_CONTRACTION_VARIABLES + 1];
+    double suffix[MAX_CONTRACTION_VARIABLES + 1];
+
+    size_t index = 0;
+    for (int dim = numVariables - 1, s = 1; dim >= 0; dim--)
+    {
+        stride[dim] = s;
+        s *= basis.getNumBasisFunctions(dim);
+    }
+
+    for (unsigned int dim = 0, offset = 0; dim < numVariables; dim++)
+    {
+        numSupportedDim[dim] = basis.getBasisDegree(dim) + 1;
+        factors[dim] = univariate + offset;
+        derivatives[dim] = factors[dim] + numSupportedDim[dim];
+        offset += (order + 1)*numSupportedDim[dim];
+
+        counter[dim] = 0;
+        index += first[dim]*stride[dim];
+    }
+
+    while (true)
+    {
+        prefix[0] = 1;
+        for (unsigned int dim = 0; dim < numVariables; dim++)
+            prefix[dim + 1] = prefix[dim]*factors[dim][counter[dim]];
+
+        const double *column = coefficients.data() + index*numOutputs;
+        double weight = prefix[numVariables];
+        for (unsigned int o = 0; o < numOutputs; o++)
+            values[o] += weight*column[o];
+
+        if (jacobian != nullptr)
+        {
+            suffix[numVariables] = 1;
+            for (int dim = numVariables - 1; dim >= 0; dim--)
+                suffix[dim] = suffix[dim + 1]*factors[dim][counter[dim]];
+
+            for (unsigned int dim = 0; dim < numVariables; dim++)
+            {
+                double derivativeWeight = prefix[dim]*derivatives[dim][counter[dim]]*suffix[dim + 1];
+                double *jacobianColumn = jacobian + dim*numOutputs;
+                for (unsigned int o = 0; o < numOutputs; o++)
+                    jacobianColumn[o] += derivativeWeight*column[o];
+            }
+        }
+
+        // Advance to the next supported basis function
+        int dim = numVariables - 1;
+        for (; dim >= 0; dim--)
+        {
+            index += stride[dim];
+            if (++counter[dim] < numSupportedDim[dim])
+                break;
+
+            index -= counter[dim]*stride[dim];
+            counter[dim] = 0;
+        }
+
+        if (dim < 0)
+            break;
+    }
+}
+
+BSpline VectorBSpline::getOutput(unsigned int output) const
+{
+    if (output >= getNumOutputs())
+        throw Exception("VectorBSpline::getOutput: Invalid output.");
+
+    return BSpline(DenseVector(coefficients.row(output).transpose()), getKnotVectors(), getBasisDegrees());
+}
+
+std::vector< std::vector<double> > VectorBSpline::getKnotVectors() const
+{
+    return basis.getKnotVectors();
+}
+
+std::vector<unsigned int> VectorBSpline::getBasisDegrees() const
+{
+    return basis.getBasisDegrees();
+}
+
+std::vector<double> VectorBSpline::getDomainUpperBound() const
+{
+    return basis.getSupportUpperBound();
+}
+
+std::vector<double> VectorBSpline::getDomainLowerBound() const
+{
+    return basis.getSupportLowerBound();
+}
+
+void VectorBSpline::setCoefficients(const DenseMatrix &coefficients)
+{
+    if (coefficients.rows() != getNumBasisFunctions())
+        throw Exception("VectorBSpline::setCoefficients: Incompatible size of coefficient matrix.");
+
+    this->coefficients = coefficients.transpose();
+}
+
+void VectorBSpline::save(const std::string &fileName) const
+{
+    Serializer s;
+    s.serialize(*this);
+    s.saveToFile(fileName);
+}
+
+void VectorBSpline::load(const std::string &fileName)
+{
+    Serializer s(fileName);
+    s.deserialize(*this);
+}
+
+} // namespace SPLINTER
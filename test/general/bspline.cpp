@@ -9,6 +9,7 @@
 
 #include <Catch.h>
 #include <bsplinetestingutilities.h>
+#include <bsplinebasis.h>
 
 using namespace SPLINTER;
 
@@ -24,4 +25,78 @@ TEST_CASE("BSpline recursive subdivision" COMMON_TEXT, COMMON_TAGS "[subdivision
 TEST_CASE("BSpline knot insertion" COMMON_TEXT, COMMON_TAGS "[knotinsertion]")
 {
     REQUIRE(testKnotInsertion());
-}
\ No newline at end of file
+}
+
+TEST_CASE("BSpline knot insertion control points" COMMON_TEXT, COMMON_TAGS "[knotinsertion]")
+{
+    std::vector<std::vector<double>> knotVectors = {
+        {0, 0, 0, 0.5, 1, 1, 1},
+        {-1, -1, -1, 0, 0.3, 1, 1, 1},
+        {2, 2, 2, 3, 4, 4, 4}
+    };
+    std::vector<unsigned int> degrees = {2, 2, 2};
+
+    BSpline bspline(knotVectors, degrees);
+    DenseVector c(bspline.getNumBasisFunctions());
+    for (int i = 0; i < c.size(); ++i)
+        c(i) = std::sin(0.7*i);
+    bspline.setCoefficients(c);
+
+    // The insertion matrices of the same basis, formed explicitly
+    BSplineBasis basis(knotVectors, degrees);
+
+    for (int step = 0; step < 3; ++step)
+    {
+        DenseMatrix controlPoints = bspline.getControlPoints();
+
+        SparseMatrix A;
+        if (step == 0)
+        {
+            bspline.insertKnots(0.7, 1, 2);
+            A = basis.insertKnots(0.7, 1, 2).toSparse();
+        }
+        else if (step == 1)
+        {
+            bspline.globalKnotRefinement();
+            A = basis.refineKnots().toSparse();
+        }
+        else
+        {
+            bspline.decomposeToBezierForm();
+            A = basis.decomposeToBezierForm().toSparse();
+        }
+
+        DenseMatrix reference = A*controlPoints;
+        REQUIRE(bspline.getControlPoints().isApprox(reference));
+    }
+}
+
+TEST_CASE("BSpline control points" COMMON_TEXT, COMMON_TAGS "[controlpoints]")
+{
+    std::vector<std::vector<double>> knotVectors = {
+        {0, 0, 0, 0, 0.5, 1, 1, 1, 1},
+        {-1, -1, 0, 1, 1}
+    };
+    BSpline bspline(knotVectors, {3, 1});
+
+    DenseMatrix controlPoints = bspline.getControlPoints();
+    REQUIRE(controlPoints.rows() == 5*3);
+    REQUIRE(controlPoints.cols() == 3);
+
+    // The first variable varies slowest
+    REQUIRE(controlPoints(0, 0) == 0);
+    REQUIRE(controlPoints(3, 0) == Approx(1.0/6));
+    REQUIRE(controlPoints(3, 1) == -1);
+    REQUIRE(controlPoints(4, 1) == 0);
+    REQUIRE(controlPoints(14, 0) == 1);
+    REQUIRE(controlPoints(14, 1) == 1);
+
+    controlPoints.col(2).setLinSpaced(controlPoints.rows(), -1, 1);
+    bspline.setControlPoints(controlPoints);
+    REQUIRE(bspline.getControlPoints() == controlPoints);
+    REQUIRE(bspline.getCoefficients() == controlPoints.col(2));
+
+    // The x-coordinates of the control points are given by the knots
+    controlPoints(2, 0) += 0.1;
+    REQUIRE_THROWS(bspline.setControlPoints(controlPoints));
+}
@@ -0,0 +1,388 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <Catch.h>
+#include <testingutilities.h>
+#include <bsplinebuilder.h>
+#include <utilities.h>
+
+using namespace SPLINTER;
+
+
+#define COMMON_TAGS "[general][bspline][builder]"
+#define COMMON_TEXT " builder test"
+
+
+// Samples a smooth function on a complete, non-uniform grid with pointsPerDim values per variable
+static DataTable sampleGrid(unsigned int dim, unsigned int pointsPerDim)
+{
+    std::vector<std::vector<double>> values(dim);
+    for (unsigned int j = 0; j < dim; ++j)
+        for (unsigned int k = 0; k < pointsPerDim; ++k)
+            values.at(j).push_back(-2.0 + 4.0*std::pow((double)k/(pointsPerDim - 1), 1.3));
+
+    DataTable table;
+    std::vector<unsigned int> index(dim, 0);
+    std::vector<double> x(dim);
+    while (true)
+    {
+        double y = 1;
+        for (unsigned int j = 0; j < dim; ++j)
+        {
+            x.at(j) = values.at(j).at(index.at(j));
+            y += std::sin((j + 1)*x.at(j)) + 0.1*x.at(j)*x.at(0);
+        }
+        table.addSample(x, y);
+
+        // Next grid point
+        unsigned int j = 0;
+        while (j < dim && ++index.at(j) == pointsPerDim)
+            index.at(j++) = 0;
+        if (j == dim)
+            break;
+    }
+
+    return table;
+}
+
+static void compareCoefficients(const BSpline &bspline, const BSpline &reference, double tolerance = 1e-8)
+{
+    DenseVector c = BSpline(bspline).getCoefficients();
+    DenseVector cref = BSpline(reference).getCoefficients();
+
+    REQUIRE(c.size() == cref.size());
+    for (int i = 0; i < c.size(); ++i)
+        REQUIRE(assertNear(c(i), cref(i), tolerance, tolerance));
+}
+
+TEST_CASE("BSpline Kronecker solver" COMMON_TEXT, COMMON_TAGS "[solver]")
+{
+    for (unsigned int dim = 1; dim <= 3; ++dim)
+    {
+        DataTable table = sampleGrid(dim, 13 - 2*dim);
+
+        for (unsigned int degree = 1; degree <= 3; ++degree)
+        {
+            // Interpolation
+            BSpline reference = BSpline::Builder(table).degree(degree).build();
+            BSpline bspline = BSpline::Builder(table).degree(degree).solver(BSpline::Solver::KRONECKER).build();
+            compareCoefficients(bspline, reference);
+
+            // Least squares fit with fewer basis functions than samples, compared to a dense least squares solution
+            bspline = BSpline::Builder(table)
+                    .degree(degree)
+                    .knotSpacing(BSpline::KnotSpacing::EQUIDISTANT)
+                    .numBasisFunctions(degree + 3)
+                    .solver(BSpline::Solver::KRONECKER)
+                    .build();
+
+            DenseMatrix B(table.getNumSamples(), bspline.getNumBasisFunctions());
+            DenseVector y(table.getNumSamples());
+            int i = 0;
+            for (auto it = table.cbegin(); it != table.cend(); ++it, ++i)
+            {
+                B.row(i) = bspline.evalBasis(vectorToDenseVector(it->getX())).transpose();
+                y(i) = it->getY();
+            }
+            reference = bspline;
+            reference.setCoefficients(B.colPivHouseholderQr().solve(y));
+
+            compareCoefficients(bspline, reference);
+        }
+    }
+}
+
+TEST_CASE("BSpline Kronecker solver" COMMON_TEXT " with smoothing", COMMON_TAGS "[solver]")
+{
+    for (unsigned int dim = 1; dim <= 3; ++dim)
+    {
+        DataTable table = sampleGrid(dim, 13 - 2*dim);
+
+        for (auto smoothing : {BSpline::Smoothing::IDENTITY, BSpline::Smoothing::PSPLINE})
+        {
+            for (unsigned int degree = 1; degree <= 3; ++degree)
+            {
+                BSpline reference = BSpline::Builder(table)
+                        .degree(degree)
+                        .smoothing(smoothing)
+                        .alpha(0.1)
+                        .build();
+                BSpline bspline = BSpline::Builder(table)
+                        .degree(degree)
+                        .smoothing(smoothing)
+                        .alpha(0.1)
+                        .solver(BSpline::Solver::KRONECKER)
+                        .build();
+                compareCoefficients(bspline, reference, 1e-7);
+            }
+        }
+    }
+}
+
+TEST_CASE("BSpline iterative solvers" COMMON_TEXT, COMMON_TAGS "[solver]")
+{
+    for (unsigned int dim = 1; dim <= 3; ++dim)
+    {
+        DataTable table = sampleGrid(dim, 13 - 2*dim);
+
+        for (auto smoothing : {BSpline::Smoothing::NONE, BSpline::Smoothing::IDENTITY, BSpline::Smoothing::PSPLINE})
+        {
+            BSpline reference = BSpline::Builder(table)
+                    .degree(3)
+                    .smoothing(smoothing)
+                    .alpha(0.1)
+                    .build();
+
+            for (auto solver : {BSpline::Solver::LSQR, BSpline::Solver::CGLS, BSpline::Solver::CG})
+            {
+                SolverStatistics statistics;
+                BSpline bspline = BSpline::Builder(table)
+                        .degree(3)
+                        .smoothing(smoothing)
+                        .alpha(0.1)
+                        .solver(solver)
+                        .tolerance(1e-12)
+                        .build(statistics);
+
+                REQUIRE(statistics.converged);
+                REQUIRE(statistics.iterations > 0);
+                REQUIRE(statistics.relativeResidual <= 1e-12);
+                compareCoefficients(bspline, reference, 1e-6);
+            }
+        }
+    }
+}
+
+TEST_CASE("BSpline iterative solvers" COMMON_TEXT " with duplicates", COMMON_TAGS "[solver]")
+{
+    DataTable table(true);
+    for (int i = 0; i < 8; ++i)
+    {
+        for (int j = 0; j < 6; ++j)
+        {
+            table.addSample(std::vector<double>{(double)i, 0.5*j*j}, std::sin(i) + j);
+            if ((i + j) % 3 == 0)
+                table.addSample(std::vector<double>{(double)i, 0.5*j*j}, std::sin(i) + j + 0.1);
+        }
+    }
+
+    BSpline reference = BSpline::Builder(table).degree(2).build();
+
+    for (auto solver : {BSpline::Solver::LSQR, BSpline::Solver::CGLS, BSpline::Solver::CG})
+    {
+        SolverStatistics statistics;
+        BSpline bspline = BSpline::Builder(table).degree(2).solver(solver).build(statistics);
+
+        REQUIRE(statistics.converged);
+        compareCoefficients(bspline, reference, 1e-6);
+    }
+}
+
+TEST_CASE("BSpline iterative solvers" COMMON_TEXT " without convergence", COMMON_TAGS "[solver]")
+{
+    DataTable table = sampleGrid(2, 9);
+
+    SolverStatistics statistics;
+    BSpline::Builder(table).smoothing(BSpline::Smoothing::PSPLINE).solver(BSpline::Solver::LSQR).maxIterations(1).build(statistics);
+    REQUIRE(!statistics.converged);
+    REQUIRE(statistics.iterations == 1);
+
+    REQUIRE_THROWS(BSpline::Builder(table).smoothing(BSpline::Smoothing::PSPLINE).solver(BSpline::Solver::LSQR).maxIterations(1).build());
+}
+
+TEST_CASE("BSpline Kronecker solver" COMMON_TEXT " with duplicates", COMMON_TAGS "[solver]")
+{
+    DataTable table(true);
+    table.addSample(std::vector<double>{0}, 0);
+    table.addSample(std::vector<double>{0}, 1);
+    table.addSample(std::vector<double>{1}, 1);
+    table.addSample(std::vector<double>{2}, 2);
+
+    REQUIRE_THROWS(BSpline::Builder(table).degree(1).solver(BSpline::Solver::KRONECKER).build());
+}
+
+TEST_CASE("BSpline fit plan" COMMON_TEXT, COMMON_TAGS "[plan]")
+{
+    for (unsigned int dim = 1; dim <= 3; ++dim)
+    {
+        DataTable table = sampleGrid(dim, 13 - 2*dim);
+
+        // Second set of sample values on the same grid
+        DataTable other;
+        DenseMatrix Y(table.getNumSamples(), 2);
+        int i = 0;
+        for (auto it = table.cbegin(); it != table.cend(); ++it, ++i)
+        {
+            double y = std::cos(it->getX().at(0)) - it->getY();
+            other.addSample(it->getX(), y);
+            Y(i, 0) = it->getY();
+            Y(i, 1) = y;
+        }
+
+        for (auto smoothing : {BSpline::Smoothing::NONE, BSpline::Smoothing::PSPLINE})
+        {
+            for (auto solver : {BSpline::Solver::DEFAULT, BSpline::Solver::KRONECKER, BSpline::Solver::LSQR})
+            {
+                BSpline::Builder builder = BSpline::Builder(table).smoothing(smoothing).solver(solver);
+                BSpline::Builder otherBuilder = BSpline::Builder(other).smoothing(smoothing).solver(solver);
+
+                BSpline::FitPlan plan = builder.plan();
+                REQUIRE(plan.getNumSamples() == table.getNumSamples());
+
+                compareCoefficients(plan.fit(DenseVector(Y.col(0))), builder.build());
+                compareCoefficients(plan.fit(DenseVector(Y.col(1))), otherBuilder.build());
+
+                std::vector<BSpline> bsplines = plan.fit(Y);
+                REQUIRE(bsplines.size() == 2);
+                compareCoefficients(bsplines.at(0), builder.build());
+                compareCoefficients(bsplines.at(1), otherBuilder.build());
+
+                REQUIRE_THROWS(plan.fit(DenseVector(Y.col(0).head(table.getNumSamples() - 1))));
+            }
+        }
+    }
+}
+
+TEST_CASE("BSpline fit plan" COMMON_TEXT " with least squares", COMMON_TAGS "[plan]")
+{
+    // Enough samples for the sparse factorization of the rectangular basis matrix
+    DataTable table = sampleGrid(3, 7);
+
+    BSpline::Builder builder = BSpline::Builder(table)
+            .degree(2)
+            .knotSpacing(BSpline::KnotSpacing::EQUIDISTANT)
+            .numBasisFunctions(5);
+
+    BSpline reference = BSpline::Builder(builder).solver(BSpline::Solver::KRONECKER).build();
+    compareCoefficients(builder.build(), reference);
+}
+
+TEST_CASE("BSpline" COMMON_TEXT " with multiple outputs", COMMON_TAGS "[multioutput]")
+{
+    for (unsigned int dim = 1; dim <= 3; ++dim)
+    {
+        DataTable table = sampleGrid(dim, 13 - 2*dim);
+
+        // One data table per output, sharing the sample points
+        const int numOutputs = 3;
+        std::vector<DataTable> tables(numOutputs);
+        DenseMatrix Y(table.getNumSamples(), numOutputs);
+        int i = 0;
+        for (auto it = table.cbegin(); it != table.cend(); ++it, ++i)
+        {
+            for (int k = 0; k < numOutputs; ++k)
+            {
+                Y(i, k) = (k + 1)*it->getY() + std::cos(k*it->getX().back());
+                tables.at(k).addSample(it->getX(), Y(i, k));
+            }
+        }
+
+        for (auto smoothing : {BSpline::Smoothing::NONE, BSpline::Smoothing::IDENTITY, BSpline::Smoothing::PSPLINE})
+        {
+            for (auto solver : {BSpline::Solver::DEFAULT, BSpline::Solver::KRONECKER, BSpline::Solver::CG})
+            {
+                std::vector<BSpline> bsplines = BSpline::Builder(table).smoothing(smoothing).solver(solver).build(Y);
+                REQUIRE(bsplines.size() == numOutputs);
+
+                for (int k = 0; k < numOutputs; ++k)
+                {
+                    BSpline reference = BSpline::Builder(tables.at(k)).smoothing(smoothing).solver(solver).build();
+                    compareCoefficients(bsplines.at(k), reference);
+                }
+            }
+        }
+
+        REQUIRE_THROWS(BSpline::Builder(table).build(DenseMatrix(Y.topRows(table.getNumSamples() - 1))));
+    }
+}
+
+TEST_CASE("BSpline online fit" COMMON_TEXT, COMMON_TAGS "[online]")
+{
+    for (unsigned int dim = 1; dim <= 3; ++dim)
+    {
+        // The coarse grid holds every other value of the fine grid in each variable
+        DataTable coarse = sampleGrid(dim, 7);
+        DataTable fine = sampleGrid(dim, 13);
+
+        for (auto smoothing : {BSpline::Smoothing::NONE, BSpline::Smoothing::IDENTITY, BSpline::Smoothing::PSPLINE})
+        {
+            // Equidistant knots only depend on the bounds of the samples, so both grids give the same knots
+            auto online = BSpline::Builder(coarse).degree(2).knotSpacing(BSpline::KnotSpacing::EQUIDISTANT)
+                    .numBasisFunctions(5).smoothing(smoothing).online();
+
+            BSpline reference = BSpline::Builder(coarse).degree(2).knotSpacing(BSpline::KnotSpacing::EQUIDISTANT)
+                    .numBasisFunctions(5).smoothing(smoothing).build();
+            compareCoefficients(online.getBSpline(), reference);
+
+            for (auto it = fine.cbegin(); it != fine.cend(); ++it)
+                if (!coarse.getSamples().count(*it))
+                    online.addSample(*it);
+
+            REQUIRE(online.getNumSamples() == fine.getNumSamples());
+
+            reference = BSpline::Builder(fine).degree(2).knotSpacing(BSpline::KnotSpacing::EQUIDISTANT)
+                    .numBasisFunctions(5).smoothing(smoothing).build();
+            compareCoefficients(online.getBSpline(), reference);
+        }
+    }
+}
+
+TEST_CASE("BSpline online fit" COMMON_TEXT " with forgetting", COMMON_TAGS "[online]")
+{
+    DataTable coarse = sampleGrid(1, 7);
+    DataTable fine = sampleGrid(1, 13);
+    double alpha = 0.1, lambda = 0.9;
+
+    auto builder = BSpline::Builder(coarse).degree(2).knotSpacing(BSpline::KnotSpacing::EQUIDISTANT)
+            .numBasisFunctions(6).smoothing(BSpline::Smoothing::IDENTITY).alpha(alpha);
+    auto online = builder.online(lambda);
+    BSpline bspline = online.getBSpline();
+
+    // Exponentially weighted normal equations, formed explicitly
+    int n = bspline.getNumBasisFunctions();
+    DenseMatrix A = alpha*DenseMatrix::Identity(n, n);
+    DenseVector rhs = DenseVector::Zero(n);
+    for (auto it = coarse.cbegin(); it != coarse.cend(); ++it)
+    {
+        DenseVector b = bspline.evalBasis(vectorToDenseVector(it->getX()));
+        A += b*b.transpose();
+        rhs += it->getY()*b;
+    }
+
+    for (auto it = fine.cbegin(); it != fine.cend(); ++it)
+    {
+        if (coarse.getSamples().count(*it))
+            continue;
+
+        DenseVector b = bspline.evalBasis(vectorToDenseVector(it->getX()));
+        A = lambda*A + b*b.transpose();
+        rhs = lambda*rhs + it->getY()*b;
+
+        online.addSample(it->getX(), it->getY());
+
+        DenseVector c = online.getCoefficients();
+        DenseVector cref = A.llt().solve(rhs);
+        for (int i = 0; i < n; ++i)
+            REQUIRE(assertNear(c(i), cref(i), 1e-8, 1e-8));
+    }
+
+    REQUIRE(online.getForgettingFactor() == lambda);
+
+    // A copy is refitted independently of the original
+    auto copy = online;
+    DenseVector before = online.getCoefficients();
+    copy.addSample(std::vector<double>{0.5}, 100);
+    REQUIRE(copy.getCoefficients() != before);
+    REQUIRE(online.getCoefficients() == before);
+
+    REQUIRE_THROWS(builder.online(0));
+    REQUIRE_THROWS(builder.online(1.5));
+    REQUIRE_THROWS(online.addSample(std::vector<double>{10}, 0));
+    REQUIRE_THROWS(online.addSample(std::vector<double>{0, 0}, 0));
+}
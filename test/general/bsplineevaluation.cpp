@@ -0,0 +1,392 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <Catch.h>
+#include <testingutilities.h>
+#include <bsplinebuilder.h>
+#include <bsplinebasis.h>
+#include <bsplinebasis1d.h>
+#include <knotintervallocator.h>
+#include <utilities.h>
+#include <unsupported/Eigen/KroneckerProduct>
+
+using namespace SPLINTER;
+
+
+#define COMMON_TAGS "[general][bspline][evaluation]"
+#define COMMON_TEXT " evaluation test"
+
+
+static BSpline buildTestBSpline(unsigned int dim, unsigned int degree)
+{
+    auto func = getTestFunction(dim, 3);
+    auto points = linspace(dim, -5, 5, std::pow(600, 1.0/dim));
+    DataTable table = sample(func, points);
+    return BSpline::Builder(table).degree(degree).build();
+}
+
+// B-spline with random coefficients and clamped knot vectors on [-5, 5] with a different number of knots per variable
+static BSpline buildRandomBSpline(unsigned int dim, unsigned int degree)
+{
+    std::vector<std::vector<double>> knotVectors;
+    for (unsigned int j = 0; j < dim; ++j)
+    {
+        std::vector<double> knots(degree + 1, -5.0);
+        for (unsigned int k = 1; k < 3 + j; ++k)
+            knots.push_back(-5.0 + 10.0*k/(3 + j));
+        knots.insert(knots.end(), degree + 1, 5.0);
+        knotVectors.push_back(knots);
+    }
+
+    std::vector<unsigned int> degrees(dim, degree);
+    BSpline bspline(knotVectors, degrees);
+    DenseVector coefficients = DenseVector::Random(bspline.getNumBasisFunctions());
+
+    return BSpline(coefficients, knotVectors, degrees);
+}
+
+// Evaluation points as the rows of a matrix, including points on the boundary of the domain
+static DenseMatrix getEvaluationPoints(unsigned int dim)
+{
+    auto points = linspace(dim, -5, 5, std::pow(200, 1.0/dim));
+
+    DenseMatrix X(points.size(), dim);
+    for (size_t i = 0; i < points.size(); ++i)
+        for (unsigned int j = 0; j < dim; ++j)
+            X(i, j) = points.at(i).at(j) + (j + 1)*1e-3*(i % 3);
+
+    // Move the perturbed points back into the domain
+    X = X.cwiseMin(5.0);
+
+    return X;
+}
+
+TEST_CASE("BSpline batch" COMMON_TEXT, COMMON_TAGS "[batch]")
+{
+    for (unsigned int dim = 1; dim <= 3; ++dim)
+    {
+        for (unsigned int degree = 1; degree <= 4; ++degree)
+        {
+            BSpline bspline = buildTestBSpline(dim, degree);
+            DenseMatrix X = getEvaluationPoints(dim);
+
+            DenseVector values(X.rows());
+            bspline.evalBatch(X, values);
+
+            DenseMatrix jacobians(X.rows(), dim);
+            bspline.evalJacobianBatch(X, jacobians);
+
+            for (int i = 0; i < X.rows(); ++i)
+            {
+                DenseVector x = X.row(i).transpose();
+                REQUIRE(assertNear(values(i), bspline.eval(x), 1e-8, 1e-8));
+
+                DenseMatrix jacobian = bspline.evalJacobian(x);
+                for (unsigned int j = 0; j < dim; ++j)
+                    REQUIRE(assertNear(jacobians(i, j), jacobian(0, j), 1e-8, 1e-8));
+            }
+        }
+    }
+}
+
+TEST_CASE("BSplineBasis tensor product" COMMON_TEXT, COMMON_TAGS "[basis]")
+{
+    for (unsigned int dim = 1; dim <= 3; ++dim)
+    {
+        for (unsigned int degree = 1; degree <= 4; ++degree)
+        {
+            BSpline bspline = buildTestBSpline(dim, degree);
+            DenseMatrix X = getEvaluationPoints(dim);
+
+            auto knotVectors = bspline.getKnotVectors();
+            BSplineBasis basis(knotVectors, bspline.getBasisDegrees());
+
+            int nnz = basis.supportedPrInterval();
+            std::vector<double> values(nnz);
+            std::vector<int> indices(nnz);
+
+            for (int i = 0; i < X.rows(); ++i)
+            {
+                DenseVector x = X.row(i).transpose();
+                REQUIRE(basis.evalSupportedTensorProduct(x.data(), values.data(), indices.data()));
+
+                DenseVector expanded = DenseVector::Zero(basis.getNumBasisFunctions());
+                for (int k = 0; k < nnz; ++k)
+                {
+                    if (k > 0)
+                        REQUIRE(indices.at(k - 1) < indices.at(k));
+                    expanded(indices.at(k)) = values.at(k);
+                }
+
+                DenseVector reference = basis.eval(x);
+                for (int k = 0; k < reference.size(); ++k)
+                    REQUIRE(assertNear(expanded(k), reference(k), 1e-10, 1e-10));
+            }
+        }
+    }
+}
+
+TEST_CASE("BSpline contraction" COMMON_TEXT, COMMON_TAGS "[contraction]")
+{
+    for (unsigned int dim = 1; dim <= 5; ++dim)
+    {
+        for (unsigned int degree = 1; degree <= 3; ++degree)
+        {
+            BSpline bspline = buildRandomBSpline(dim, degree);
+            DenseVector coefficients = bspline.getCoefficients();
+            DenseMatrix X = getEvaluationPoints(dim);
+
+            for (int i = 0; i < X.rows(); ++i)
+            {
+                // Reference value from the Kronecker product of the basis functions
+                DenseVector x = X.row(i).transpose();
+                double reference = coefficients.dot(DenseVector(bspline.evalBasis(x)));
+
+                REQUIRE(assertNear(bspline.eval(x), reference, 1e-10, 1e-10));
+            }
+        }
+    }
+}
+
+TEST_CASE("BSpline gradient" COMMON_TEXT, COMMON_TAGS "[gradient]")
+{
+    for (unsigned int dim = 1; dim <= 5; ++dim)
+    {
+        for (unsigned int degree = 1; degree <= 3; ++degree)
+        {
+            BSpline bspline = buildRandomBSpline(dim, degree);
+            DenseVector coefficients = bspline.getCoefficients();
+            DenseMatrix X = getEvaluationPoints(dim);
+
+            auto knotVectors = bspline.getKnotVectors();
+            BSplineBasis basis(knotVectors, bspline.getBasisDegrees());
+
+            for (int i = 0; i < X.rows(); ++i)
+            {
+                DenseVector x = X.row(i).transpose();
+
+                // Reference Jacobian from the dense Kronecker products of the basis functions
+                DenseMatrix reference = coefficients.transpose()*basis.evalBasisJacobianOld(x);
+
+                DenseMatrix jacobian = bspline.evalJacobian(x);
+                DenseMatrix sparseJacobian = coefficients.transpose()*bspline.evalBasisJacobian(x);
+
+                REQUIRE(jacobian.rows() == 1);
+                REQUIRE(jacobian.cols() == (int)dim);
+                for (unsigned int j = 0; j < dim; ++j)
+                {
+                    REQUIRE(assertNear(jacobian(0, j), reference(0, j), 1e-10, 1e-10));
+                    REQUIRE(assertNear(sparseJacobian(0, j), reference(0, j), 1e-10, 1e-10));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("BSpline Hessian" COMMON_TEXT, COMMON_TAGS "[hessian]")
+{
+    for (unsigned int dim = 1; dim <= 4; ++dim)
+    {
+        for (unsigned int degree = 1; degree <= 3; ++degree)
+        {
+            BSpline bspline = buildRandomBSpline(dim, degree);
+            DenseVector coefficients = bspline.getCoefficients();
+            DenseMatrix X = getEvaluationPoints(dim);
+
+            auto knotVectors = bspline.getKnotVectors();
+            BSplineBasis basis(knotVectors, bspline.getBasisDegrees());
+
+            // Reference Hessian from the sparse basis Hessian, which holds the lower triangle
+            DenseMatrix identity = DenseMatrix::Identity(dim, dim);
+            DenseMatrix caug = Eigen::kroneckerProduct(identity, coefficients.transpose());
+
+            for (int i = 0; i < X.rows(); ++i)
+            {
+                DenseVector x = X.row(i).transpose();
+                DenseMatrix reference = caug*basis.evalBasisHessian(x);
+
+                DenseMatrix hessian = bspline.evalHessian(x);
+
+                REQUIRE(hessian.rows() == (int)dim);
+                REQUIRE(hessian.cols() == (int)dim);
+                for (unsigned int j = 0; j < dim; ++j)
+                {
+                    for (unsigned int k = 0; k <= j; ++k)
+                    {
+                        REQUIRE(assertNear(hessian(j, k), reference(j, k), 1e-10, 1e-10));
+                        REQUIRE(hessian(k, j) == hessian(j, k));
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("BSpline evalAll" COMMON_TEXT, COMMON_TAGS "[hessian]")
+{
+    for (unsigned int dim = 1; dim <= 4; ++dim)
+    {
+        for (unsigned int degree = 1; degree <= 3; ++degree)
+        {
+            BSpline bspline = buildRandomBSpline(dim, degree);
+            DenseMatrix X = getEvaluationPoints(dim);
+
+            for (int i = 0; i < X.rows(); ++i)
+            {
+                DenseVector x = X.row(i).transpose();
+
+                double value = bspline.eval(x);
+                DenseMatrix jacobian = bspline.evalJacobian(x);
+                DenseMatrix hessian = bspline.evalHessian(x);
+
+                for (unsigned int order = 0; order <= 2; ++order)
+                {
+                    BSpline::Evaluation evaluation = bspline.evalAll(x, order);
+
+                    REQUIRE(evaluation.value == value);
+                    REQUIRE(evaluation.jacobian.size() == (order >= 1 ? (int)dim : 0));
+                    REQUIRE(evaluation.hessian.size() == (order >= 2 ? (int)(dim*dim) : 0));
+
+                    if (order >= 1)
+                        REQUIRE(evaluation.jacobian == jacobian);
+                    if (order >= 2)
+                        REQUIRE(evaluation.hessian == hessian);
+                }
+            }
+        }
+    }
+
+    BSpline bspline = buildTestBSpline(2, 3);
+    DenseVector x = DenseVector::Zero(2);
+    REQUIRE_THROWS(bspline.evalAll(x, 3));
+}
+
+TEST_CASE("BSpline batch" COMMON_TEXT " outside domain", COMMON_TAGS "[batch]")
+{
+    BSpline bspline = buildTestBSpline(2, 3);
+
+    DenseMatrix X(2, 2);
+    X << 6, 0,
+         0, -6;
+
+    DenseVector values = DenseVector::Ones(2);
+    bspline.evalBatch(X, values);
+    REQUIRE(values.isZero());
+
+    DenseMatrix jacobians = DenseMatrix::Ones(2, 2);
+    bspline.evalJacobianBatch(X, jacobians);
+    REQUIRE(jacobians.isZero());
+}
+
+TEST_CASE("BSplineBasis1D derivative" COMMON_TEXT, COMMON_TAGS "[basis]")
+{
+    // Covers both the degree-specialized kernels and the generic kernel
+    for (unsigned int degree = 1; degree <= MAX_KERNEL_DEGREE + 2; ++degree)
+    {
+        // Clamped knot vector with an interior knot of multiplicity two
+        std::vector<double> knots(degree + 1, -1.0);
+        for (double knot : {-0.5, 0.0, 0.0, 0.3, 0.7})
+            knots.push_back(knot);
+        for (unsigned int i = 0; i <= degree; ++i)
+            knots.push_back(1.0);
+
+        BSplineBasis1D basis(knots, degree);
+
+        for (double x = -1.0; x <= 1.0; x += 0.0625)
+        {
+            // The first derivative is also nonzero for linear basis functions
+            DenseVector derivative = basis.evalDerivative(x, 1);
+            DenseVector reference = basis.evalFirstDerivative(x);
+
+            REQUIRE(derivative.size() == reference.size());
+            for (int i = 0; i < reference.size(); ++i)
+                REQUIRE(assertNear(derivative(i), reference(i), 1e-10, 1e-10));
+
+            // Partition of unity
+            REQUIRE(assertNear(DenseVector(basis.eval(x)).sum(), 1.0, 1e-12, 1e-12));
+        }
+    }
+}
+
+TEST_CASE("KnotIntervalLocator" COMMON_TEXT, COMMON_TAGS "[locator]")
+{
+    // Uniform and clamped, non-uniform and clamped, and non-uniform with repeated interior knots
+    std::vector<std::vector<double>> knotVectors = {
+        {0, 0, 0, 0, 1, 2, 3, 4, 5, 5, 5, 5},
+        {-1, -1, -0.9, -0.5, 0.1, 0.2, 0.25, 3, 3},
+        {0, 0, 0.5, 0.5, 0.5, 1, 1.5, 1.5, 4, 4}
+    };
+
+    for (auto &knots : knotVectors)
+    {
+        KnotIntervalLocator locator(knots);
+
+        int hint = -1;
+        for (double x = knots.front(); x <= knots.back(); x += 0.01)
+        {
+            int expected = std::upper_bound(knots.begin(), knots.end(), x) - knots.begin() - 1;
+            REQUIRE(locator.find(x) == expected);
+
+            // Sorted queries with the previous result as hint
+            hint = locator.find(x, hint);
+            REQUIRE(hint == expected);
+
+            // Hint far away from the result
+            REQUIRE(locator.find(x, knots.size() - 2 - expected) == expected);
+        }
+
+        // Knots and right boundary
+        for (double x : knots)
+        {
+            int expected = std::upper_bound(knots.begin(), knots.end(), x) - knots.begin() - 1;
+            REQUIRE(locator.find(x) == expected);
+            REQUIRE(locator.find(x, 0) == expected);
+        }
+    }
+
+    REQUIRE(KnotIntervalLocator(knotVectors.at(0)).isUniform());
+    REQUIRE(!KnotIntervalLocator(knotVectors.at(1)).isUniform());
+}
+
+TEST_CASE("BSplineBasis1D batch" COMMON_TEXT, COMMON_TAGS "[basis][batch]")
+{
+    for (unsigned int degree = 1; degree <= MAX_KERNEL_DEGREE + 2; ++degree)
+    {
+        // Knot vector that is not clamped, with a repeated interior knot
+        std::vector<double> knots;
+        for (double knot : {-2.0, -1.5, -1.0, -0.5, 0.0, 0.0, 0.3, 0.7, 1.0, 1.2, 1.5, 2.0, 2.5, 3.0, 3.5, 4.0})
+            knots.push_back(knot);
+
+        BSplineBasis1D basis(knots, degree);
+
+        // Unsorted points, including the knots and the ends of the support (not a multiple of the SIMD width)
+        std::vector<double> x;
+        for (int i = 0; i < 301; ++i)
+            x.push_back(-2.0 + 6.0*((i*37) % 301)/300.0);
+        for (double knot : knots)
+            x.push_back(knot);
+
+        for (unsigned int r = 0; r <= 2; ++r)
+        {
+            std::vector<double> values(x.size()*(degree + 1));
+            std::vector<unsigned int> first(x.size());
+            basis.evalBatch(x.data(), x.size(), values.data(), first.data(), r);
+
+            std::vector<double> reference(degree + 1);
+            for (size_t i = 0; i < x.size(); ++i)
+            {
+                unsigned int referenceFirst = basis.evalSupportedDerivative(x.at(i), r, reference.data());
+                REQUIRE(first.at(i) == referenceFirst);
+
+                for (unsigned int k = 0; k <= degree; ++k)
+                    REQUIRE(assertNear(values.at(i*(degree + 1) + k), reference.at(k), 1e-12, 1e-12));
+            }
+        }
+    }
+}
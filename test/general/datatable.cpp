@@ -10,6 +10,10 @@
 #include <Catch.h>
 #include <testingutilities.h>
 #include <datatable.h>
+#include <fstream>
+#include <iomanip>
+#include <clocale>
+#include <limits>
 
 using namespace SPLINTER;
 
@@ -103,3 +107,277 @@ TEST_CASE("DataTable set operations", COMMON_TAGS) {
     auto table4 = table3 + table3;
     CHECK(table4 == table3);
 }
+
+TEST_CASE("DataTable columnar storage", COMMON_TAGS)
+{
+    DataTable table;
+    table.addSample(std::vector<double>{2, 1}, 4);
+    table.addSample(std::vector<double>{1, 3}, 2);
+    table.addSample(std::vector<double>{1, 1}, 1);
+
+    // Sorted by x on access
+    REQUIRE(table.getNumSamples() == 3);
+    REQUIRE(table.getColumnX(0)[0] == 1);
+    REQUIRE(table.getColumnX(1)[0] == 1);
+    REQUIRE(table.getColumnX(1)[1] == 3);
+    REQUIRE(table.getColumnX(0)[2] == 2);
+    REQUIRE(table.getColumnY()[0] == 1);
+    REQUIRE(table.getColumnY()[1] == 2);
+    REQUIRE(table.getColumnY()[2] == 4);
+    REQUIRE_THROWS(table.getColumnX(2));
+
+    // Samples appended after sorting are merged, and later duplicates are discarded
+    table.addSample(std::vector<double>{1, 2}, 3);
+    table.addSample(std::vector<double>{1, 1}, 10);
+    table.addSample(std::vector<double>{2, 3}, 6);
+    REQUIRE(table.getNumSamples() == 5);
+    REQUIRE(!table.isGridComplete());
+    table.addSample(std::vector<double>{2, 2}, 5);
+    REQUIRE(table.isGridComplete());
+
+    std::vector<double> y = table.getVectorY();
+    REQUIRE(y == std::vector<double>({1, 3, 2, 4, 5, 6}));
+
+    int i = 0;
+    for (auto it = table.cbegin(); it != table.cend(); ++it, ++i)
+    {
+        REQUIRE(it->getX().at(0) == table.getColumnX(0)[i]);
+        REQUIRE(it->getX().at(1) == table.getColumnX(1)[i]);
+        REQUIRE(it->getX(1) == table.getColumnX(1)[i]);
+        REQUIRE(it->getY() == table.getColumnY()[i]);
+
+        DataPoint point = *it;
+        REQUIRE(point.getX() == it->getX());
+        REQUIRE(point.getY() == it->getY());
+    }
+    REQUIRE(i == 6);
+    REQUIRE_THROWS(table.cbegin()->getX(2));
+
+    // Duplicates are kept (in insertion order) and counted if allowed
+    DataTable duplicates(true);
+    duplicates.addSample(1, 2);
+    duplicates.addSample(0, 1);
+    duplicates.addSample(1, 3);
+    REQUIRE(duplicates.getNumSamples() == 3);
+    REQUIRE(duplicates.getVectorY() == std::vector<double>({1, 2, 3}));
+    REQUIRE(duplicates.isGridComplete());
+}
+
+TEST_CASE("DataTable bulk sample ingestion", COMMON_TAGS)
+{
+    // A shuffled 40 x 40 x 40 grid, large enough to be sorted in several chunks, with duplicated samples
+    const unsigned int numVariables = 3;
+    std::vector<std::vector<double>> points;
+    for (int a = 0; a < 40; ++a)
+        for (int b = 0; b < 40; ++b)
+            for (int c = 0; c < 40; ++c)
+                points.push_back({(double)c, 0.5*b, -a + 0.0});
+
+    for (size_t j = 0; j < 1000; ++j)
+        points.push_back(points.at(37*j));
+
+    for (size_t j = points.size() - 1; j > 0; --j)
+        std::swap(points.at(j), points.at((j*7919 + 13) % (j + 1)));
+
+    size_t n = points.size();
+    std::vector<double> rowMajor(n*numVariables), colMajor(n*numVariables), y(n);
+    DataTable expected;
+    for (size_t j = 0; j < n; ++j)
+    {
+        for (unsigned int i = 0; i < numVariables; ++i)
+        {
+            rowMajor.at(j*numVariables + i) = points.at(j).at(i);
+            colMajor.at(i*n + j) = points.at(j).at(i);
+        }
+        y.at(j) = points.at(j).at(0) + 2*points.at(j).at(1) - points.at(j).at(2);
+        expected.addSample(points.at(j), y.at(j));
+    }
+
+    DataTable tableRowMajor;
+    tableRowMajor.addSamples(rowMajor.data(), y.data(), n, numVariables, DataTable::Layout::ROW_MAJOR);
+    REQUIRE(tableRowMajor.getNumSamples() == 64000);
+    REQUIRE(tableRowMajor.isGridComplete());
+    REQUIRE(tableRowMajor == expected);
+
+    DataTable tableColMajor;
+    tableColMajor.addSamples(colMajor.data(), y.data(), n, numVariables, DataTable::Layout::COLUMN_MAJOR);
+    REQUIRE(tableColMajor == expected);
+
+    // Sorted samples are merged with the next batch
+    DataTable tableBatches;
+    tableBatches.addSamples(rowMajor.data(), y.data(), n/2, numVariables);
+    REQUIRE(tableBatches.getNumSamples() <= n/2);
+    tableBatches.addSamples(rowMajor.data() + (n/2)*numVariables, y.data() + n/2, n - n/2, numVariables);
+    REQUIRE(tableBatches == expected);
+
+    for (size_t j = 1; j < tableBatches.getNumSamples(); ++j)
+        REQUIRE(tableBatches.getSample(j - 1) < tableBatches.getSample(j));
+
+    REQUIRE_THROWS(tableBatches.addSamples(rowMajor.data(), y.data(), 1, 2));
+}
+
+TEST_CASE("DataTable import from CSV and raw files", COMMON_TAGS)
+{
+    const char *fileName = "test.datatable.import";
+
+    DataTable expected;
+    for (int i = 0; i < 30; ++i)
+        for (int j = 0; j < 20; ++j)
+            expected.addSample(std::vector<double>{0.1*i, -2.5 + j}, i*j + 0.25);
+
+    ImportOptions options;
+    // Small blocks, so that lines are split across blocks
+    options.blockSize = 100;
+
+    SECTION("CSV")
+    {
+        {
+            std::ofstream out(fileName);
+            out << std::setprecision(17);
+            out << "x0;x1;y\n";
+            out << "# units\n";
+            out << "\n";
+            for (int j = 19; j >= 0; --j)
+            {
+                for (int i = 0; i < 30; ++i)
+                    out << 0.1*i << "; " << -2.5 + j << " ;" << i*j + 0.25 << (j % 2 ? "\r\n" : "\n");
+                out << "  \n";
+            }
+        }
+
+        options.delimiter = ';';
+        options.numHeaderLines = 2;
+
+        ImportStatistics statistics;
+        DataTable table = DataTable::fromCsv(fileName, options, statistics);
+        REQUIRE(table == expected);
+        REQUIRE(statistics.numSamples == 600);
+        REQUIRE(statistics.seconds >= 0);
+
+        // The default block size reads the file at once
+        options.blockSize = ImportOptions().blockSize;
+        REQUIRE(DataTable::fromCsv(fileName, options) == expected);
+
+        // Numbers are read with '.' as the decimal separator in a locale that uses ',' (if one is installed)
+        const char *commaLocales[] = {"de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8"};
+        for (const char *locale : commaLocales)
+        {
+            if (std::setlocale(LC_NUMERIC, locale) != nullptr)
+            {
+                DataTable localeTable = DataTable::fromCsv(fileName, options);
+                std::setlocale(LC_NUMERIC, "C");
+                REQUIRE(localeTable == expected);
+                break;
+            }
+        }
+
+        // Malformed lines are reported
+        {
+            std::ofstream out(fileName);
+            out << "1,2\n3,4\n5,,6\n";
+        }
+        REQUIRE_THROWS(DataTable::fromCsv(fileName));
+
+        {
+            std::ofstream out(fileName);
+            out << "1,2,3\n3,4\n";
+        }
+        REQUIRE_THROWS(DataTable::fromCsv(fileName));
+    }
+
+    SECTION("Raw")
+    {
+        {
+            std::ofstream out(fileName, std::ofstream::binary);
+            for (int i = 29; i >= 0; --i)
+            {
+                for (int j = 0; j < 20; ++j)
+                {
+                    double record[3] = {0.1*i, -2.5 + j, i*j + 0.25};
+                    out.write(reinterpret_cast<const char *>(record), sizeof(record));
+                }
+            }
+        }
+
+        ImportStatistics statistics;
+        DataTable table = DataTable::fromRaw(fileName, 2, options, statistics);
+        REQUIRE(table == expected);
+        REQUIRE(statistics.numSamples == 600);
+        REQUIRE(statistics.numBytes == 600*3*sizeof(double));
+
+        // The file size must be a multiple of the record size
+        REQUIRE_THROWS(DataTable::fromRaw(fileName, 6));
+    }
+
+    remove(fileName);
+}
+
+TEST_CASE("DataTable grid and grid indices", COMMON_TAGS)
+{
+    DataTable table(false, true);
+    table.addSample(std::vector<double>{3, -1}, 1);
+    table.addSample(std::vector<double>{1, 2}, 2);
+    table.addSample(std::vector<double>{3, 2}, 3);
+    table.addSample(std::vector<double>{0.5, -1}, 4);
+
+    const auto &grid = table.getGrid();
+    REQUIRE(grid.size() == 2);
+    REQUIRE(grid.at(0) == std::vector<double>({0.5, 1, 3}));
+    REQUIRE(grid.at(1) == std::vector<double>({-1, 2}));
+    REQUIRE(!table.isGridComplete());
+
+    // The grid value of each sample (sorted by x) is found at its grid index
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        const unsigned int *indices = table.getGridIndices(i);
+        for (unsigned int j = 0; j < table.getNumSamples(); ++j)
+            REQUIRE(table.getGrid().at(i).at(indices[j]) == table.getColumnX(i)[j]);
+    }
+    REQUIRE(table.getGridIndices(0)[3] == 2);
+    REQUIRE_THROWS(table.getGridIndices(2));
+
+    // Adding samples updates the grid and the indices
+    table.addSample(std::vector<double>{0.5, 2}, 5);
+    table.addSample(std::vector<double>{1, -1}, 6);
+    REQUIRE(table.isGridComplete());
+    REQUIRE(table.getGridIndices(1)[5] == 1);
+    REQUIRE(table.getGrid().at(0).size() == 3);
+
+    // Sample points that are not finite are rejected, and the table is left unchanged
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    double X[] = {2, 2, nan, 1};
+    double y[] = {7, 8};
+    REQUIRE_THROWS(table.addSample(std::vector<double>{nan, 1}, 7));
+    REQUIRE_THROWS(table.addSample(std::vector<double>{1, std::numeric_limits<double>::infinity()}, 7));
+    REQUIRE_THROWS(table.addSamples(X, y, 2, 2));
+    REQUIRE(table.getNumSamples() == 6);
+    REQUIRE(table.getGridIndices(0)[5] == 2);
+}
+
+TEST_CASE("DataTable concurrent const access", COMMON_TAGS)
+{
+    DataTable table(false, true);
+    for (int i = 0; i < 200; ++i)
+        table.addSample(std::vector<double>{(double) ((i*37) % 200), (double) (i % 7)}, i);
+
+    // Concurrent readers all trigger the lazy sorting and grid construction of the same table
+    const int numReaders = 16;
+    std::vector<size_t> numSamples(numReaders), gridSize(numReaders);
+    std::vector<double> lastIndex(numReaders);
+
+    #pragma omp parallel for
+    for (int r = 0; r < numReaders; ++r)
+    {
+        const DataTable &reader = table;
+        gridSize[r] = reader.getGrid().at(0).size();
+        lastIndex[r] = reader.getGridIndices(0)[reader.getNumSamples() - 1];
+        numSamples[r] = reader.getNumSamples();
+    }
+
+    for (int r = 0; r < numReaders; ++r)
+    {
+        REQUIRE(numSamples.at(r) == 200);
+        REQUIRE(gridSize.at(r) == 200);
+        REQUIRE(lastIndex.at(r) == 199);
+    }
+}
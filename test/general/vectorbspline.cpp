@@ -0,0 +1,121 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <Catch.h>
+#include <datatable.h>
+#include <bsplinebuilder.h>
+#include <vectorbspline.h>
+#include <utilities.h>
+#include "testingutilities.h"
+
+using namespace SPLINTER;
+
+#define COMMON_TAGS "[general][vectorbspline]"
+#define COMMON_TEXT " vector B-spline test"
+
+TEST_CASE("VectorBSpline evaluation" COMMON_TEXT, COMMON_TAGS "[evaluation]")
+{
+    const int numOutputs = 3;
+
+    for (unsigned int dim = 1; dim <= 3; ++dim)
+    {
+        auto func = getTestFunction(dim, 2);
+        auto points = linspace(dim, std::pow(300, 1.0/dim));
+        DataTable table = sample(func, points);
+
+        DenseMatrix Y(table.getNumSamples(), numOutputs);
+        int i = 0;
+        for (auto it = table.cbegin(); it != table.cend(); ++it, ++i)
+            for (int k = 0; k < numOutputs; ++k)
+                Y(i, k) = (k + 1)*it->getY() + std::sin(k*it->getX().front());
+
+        for (unsigned int degree = 1; degree <= 3; ++degree)
+        {
+            std::vector<BSpline> bsplines = BSpline::Builder(table).degree(degree).build(Y);
+            VectorBSpline vectorBSpline(bsplines);
+
+            REQUIRE(vectorBSpline.getNumVariables() == dim);
+            REQUIRE(vectorBSpline.getNumOutputs() == numOutputs);
+            REQUIRE(vectorBSpline.getNumBasisFunctions() == bsplines.front().getNumBasisFunctions());
+
+            auto evalPoints = linspace(dim, 7);
+            for (auto &x : evalPoints)
+            {
+                DenseVector xvec = vectorToDenseVector(x);
+                DenseVector values = vectorBSpline.eval(xvec);
+                DenseMatrix jacobian = vectorBSpline.evalJacobian(xvec);
+
+                REQUIRE(jacobian.rows() == numOutputs);
+                REQUIRE(jacobian.cols() == dim);
+
+                for (int k = 0; k < numOutputs; ++k)
+                {
+                    REQUIRE(values(k) == Approx(bsplines.at(k).eval(xvec)));
+
+                    DenseMatrix reference = bsplines.at(k).evalJacobian(xvec);
+                    for (unsigned int j = 0; j < dim; ++j)
+                        REQUIRE(equalsWithinRange(jacobian(k, j), reference(0, j), 1e-10));
+                }
+            }
+
+            for (int k = 0; k < numOutputs; ++k)
+                REQUIRE(compareBSplines(vectorBSpline.getOutput(k), bsplines.at(k)));
+
+            REQUIRE_THROWS(vectorBSpline.getOutput(numOutputs));
+            REQUIRE_THROWS(vectorBSpline.eval(DenseVector::Zero(dim + 1)));
+
+            // Points outside the domain are rejected in debug builds (as by BSpline), and give zeros otherwise
+            DenseVector outside = vectorToDenseVector(vectorBSpline.getDomainUpperBound()).array() + 1;
+#ifndef NDEBUG
+            REQUIRE_THROWS(vectorBSpline.eval(outside));
+            REQUIRE_THROWS(vectorBSpline.evalJacobian(outside));
+            std::vector<double> outsideValues(numOutputs);
+            REQUIRE_THROWS(vectorBSpline.eval(outside.data(), outsideValues.data()));
+#else
+            REQUIRE(vectorBSpline.eval(outside).isZero());
+            REQUIRE(vectorBSpline.evalJacobian(outside).isZero());
+#endif // NDEBUG
+        }
+    }
+}
+
+TEST_CASE("VectorBSpline coefficients" COMMON_TEXT, COMMON_TAGS "[coefficients]")
+{
+    unsigned int dim = 2;
+    auto func = getTestFunction(dim, 2);
+    auto points = linspace(dim, 10);
+    DataTable table = sample(func, points);
+
+    DenseMatrix Y(table.getNumSamples(), 2);
+    int i = 0;
+    for (auto it = table.cbegin(); it != table.cend(); ++it, ++i)
+    {
+        Y(i, 0) = it->getY();
+        Y(i, 1) = -it->getY();
+    }
+
+    std::vector<BSpline> bsplines = BSpline::Builder(table).degree(3).build(Y);
+    VectorBSpline vectorBSpline(bsplines);
+
+    DenseMatrix coefficients = vectorBSpline.getCoefficients();
+    REQUIRE(coefficients.rows() == bsplines.front().getNumBasisFunctions());
+    REQUIRE(coefficients.cols() == 2);
+    REQUIRE(coefficients.col(0) == bsplines.at(0).getCoefficients());
+
+    // Same spline from the coefficient matrix, knot vectors and degrees
+    VectorBSpline copy(coefficients, vectorBSpline.getKnotVectors(), vectorBSpline.getBasisDegrees());
+    DenseVector x = vectorToDenseVector(std::vector<double>{0.3, -0.2});
+    REQUIRE(copy.eval(x) == vectorBSpline.eval(x));
+
+    REQUIRE_THROWS(copy.setCoefficients(DenseMatrix::Zero(coefficients.rows() - 1, 2)));
+
+    // The B-splines must share the basis
+    bsplines.push_back(BSpline::Builder(table).degree(2).build());
+    REQUIRE_THROWS(VectorBSpline(bsplines).getNumOutputs());
+}
@@ -84,12 +84,9 @@ bool operator==(const DataTable &lhs, const DataTable &rhs)
     return
             lhs.allowDuplicates == rhs.allowDuplicates
             && lhs.allowIncompleteGrid == rhs.allowIncompleteGrid
-            && lhs.numDuplicates == rhs.numDuplicates
-            && lhs.numVariables == rhs.numVariables
-            && lhs.samples == rhs.samples
-            && lhs.grid == rhs.grid
             && lhs.getNumVariables() == rhs.getNumVariables()
             && lhs.getNumSamples() == rhs.getNumSamples()
+            && lhs.numDuplicates == rhs.numDuplicates
             && lhs.getSamples() == rhs.getSamples()
             && lhs.getGrid() == rhs.getGrid();
 }
@@ -122,6 +119,16 @@ bool operator==(const BSpline &lhs, const BSpline &rhs)
             && lhs.getDomainUpperBound() == rhs.getDomainUpperBound();
 }
 
+bool operator==(const VectorBSpline &lhs, const VectorBSpline &rhs)
+{
+    return
+            lhs.numVariables == rhs.numVariables
+            && lhs.coefficients == rhs.coefficients
+            && lhs.basis == rhs.basis
+            && lhs.getKnotVectors() == rhs.getKnotVectors()
+            && lhs.getBasisDegrees() == rhs.getBasisDegrees();
+}
+
 bool operator==(const BSplineBasis &lhs, const BSplineBasis &rhs)
 {
     return
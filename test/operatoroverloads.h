@@ -16,6 +16,7 @@
 #include <datapoint.h>
 #include <datatable.h>
 #include <bspline.h>
+#include <vectorbspline.h>
 
 
 /*
@@ -45,6 +46,7 @@ namespace SPLINTER
 bool operator==(const DataTable &lhs, const DataTable &rhs);
 bool operator==(const DataPoint &lhs, const DataPoint &rhs);
 bool operator==(const BSpline &lhs, const BSpline &rhs);
+bool operator==(const VectorBSpline &lhs, const VectorBSpline &rhs);
 bool operator==(const BSplineBasis &lhs, const BSplineBasis &rhs);
 bool operator==(const BSplineBasis1D &lhs, const BSplineBasis1D &rhs);
 
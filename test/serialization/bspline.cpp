@@ -11,6 +11,9 @@
 #include <datatable.h>
 #include <bsplinebuilder.h>
 #include "testingutilities.h"
+#include <serializer.h>
+#include <fstream>
+#include <iterator>
 
 using namespace SPLINTER;
 
@@ -62,3 +65,56 @@ TEST_CASE("BSpline can be saved and loaded", COMMON_TAGS)
 
     remove(fileName);
 }
+
+static std::vector<char> readBytes(const std::string &fileName)
+{
+    std::ifstream ifs(fileName, std::ifstream::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+static void writeBytes(const std::string &fileName, const std::vector<char> &bytes)
+{
+    std::ofstream ofs(fileName, std::ofstream::binary);
+    ofs.write(bytes.data(), bytes.size());
+}
+
+TEST_CASE("BSpline files of older format versions can be loaded", COMMON_TAGS)
+{
+    unsigned int dim = 2;
+    auto func = getTestFunction(dim, 1);
+    auto points = linspace(dim, std::pow(300, 1.0/dim));
+    DataTable table = sample(func, points);
+    BSpline bspline = BSpline::Builder(table).degree(3).build();
+
+    const char *fileName = "test.bspline";
+    bspline.save(fileName);
+    std::vector<char> bytes = readBytes(fileName);
+
+    /*
+     * Version 2 is the tag (8 bytes), basis, coefficients and numVariables. Version 1 has no tag,
+     * and the knot averages (the control point x-coordinates) between the basis and the coefficients.
+     */
+    size_t tagSize = 2*sizeof(uint32_t);
+    size_t tailSize = Serializer::get_size(bspline.getCoefficients()) + sizeof(unsigned int);
+    std::vector<char> basisBytes(bytes.begin() + tagSize, bytes.end() - tailSize);
+
+    Serializer averagesSerializer;
+    averagesSerializer.serialize(DenseMatrix(bspline.getControlPoints().leftCols(dim)));
+    averagesSerializer.saveToFile(fileName);
+    std::vector<char> averagesBytes = readBytes(fileName);
+
+    std::vector<char> version1 = basisBytes;
+    version1.insert(version1.end(), averagesBytes.begin(), averagesBytes.end());
+    version1.insert(version1.end(), bytes.end() - tailSize, bytes.end());
+    writeBytes(fileName, version1);
+
+    REQUIRE(BSpline(fileName) == bspline);
+
+    // Newer versions are rejected
+    std::vector<char> version99 = bytes;
+    version99.at(sizeof(uint32_t)) = 99;
+    writeBytes(fileName, version99);
+    REQUIRE_THROWS(BSpline(fileName).getNumVariables());
+
+    remove(fileName);
+}
@@ -9,6 +9,9 @@
 
 #include <Catch.h>
 #include <datatable.h>
+#include <bsplinebuilder.h>
+#include <serializer.h>
+#include <fstream>
 #include "testingutilities.h"
 
 using namespace SPLINTER;
@@ -57,3 +60,133 @@ TEST_CASE("DataTable can be saved and loaded", COMMON_TAGS)
 
     remove(fileName);
 }
+
+TEST_CASE("DataTable can be saved and mapped in the columnar format", COMMON_TAGS)
+{
+    const char *fileName = "test.datatable.columnar";
+
+    SECTION("DataTable with 0 samples")
+    {
+        DataTable table;
+        table.saveColumnar(fileName);
+        DataTable loadedTable(fileName);
+
+        REQUIRE(table == loadedTable);
+    }
+
+    SECTION("DataTable with samples from f_2_1")
+    {
+        auto testFunc = getTestFunction(2, 1);
+        auto dim = testFunc->getNumVariables();
+        auto points = linspace(dim, std::pow(1000, 1.0/dim));
+        DataTable table = sample(testFunc, points);
+
+        table.saveColumnar(fileName);
+        DataTable loadedTable(fileName);
+
+        REQUIRE(table == loadedTable);
+        REQUIRE(loadedTable.isGridComplete());
+
+        // The columns are read from the file, and are aligned
+        REQUIRE(reinterpret_cast<uintptr_t>(loadedTable.getColumnX(1)) % 64 == 0);
+        REQUIRE(reinterpret_cast<uintptr_t>(loadedTable.getColumnY()) % 64 == 0);
+
+        // A B-spline built from the mapped table is identical
+        BSpline bspline = BSpline::Builder(table).degree(3).build();
+        BSpline loadedBSpline = BSpline::Builder(loadedTable).degree(3).build();
+        REQUIRE(bspline == loadedBSpline);
+
+        // A mapped table can be saved in the serialized format (from the file), and extended
+        const char *serializedFileName = "test.datatable";
+        const double *mappedColumn = loadedTable.getColumnX(0);
+        loadedTable.save(serializedFileName);
+        REQUIRE(loadedTable.getColumnX(0) == mappedColumn);
+        REQUIRE(DataTable(serializedFileName) == table);
+        remove(serializedFileName);
+
+        DataTable extendedTable(fileName);
+        extendedTable.addSample(std::vector<double>{100, 100}, 1);
+        table.addSample(std::vector<double>{100, 100}, 1);
+        REQUIRE(extendedTable == table);
+    }
+
+    SECTION("Unsupported versions are rejected")
+    {
+        DataTable table;
+        table.addSample(1, 2);
+        table.saveColumnar(fileName);
+
+        // The version follows the 8 byte magic number
+        {
+            std::fstream fs(fileName, std::fstream::in | std::fstream::out | std::fstream::binary);
+            fs.seekp(8);
+            uint32_t version = 2;
+            fs.write(reinterpret_cast<const char *>(&version), sizeof(version));
+        }
+
+        REQUIRE_THROWS(DataTable(fileName).getNumSamples());
+    }
+
+    SECTION("Corrupt sizes are rejected")
+    {
+        DataTable table;
+        table.addSample(1, 2);
+        table.saveColumnar(fileName);
+
+        // numSamples and columnStride (at byte 24 and 40) chosen such that their products overflow 64 bits
+        {
+            std::fstream fs(fileName, std::fstream::in | std::fstream::out | std::fstream::binary);
+            uint64_t numSamples = (uint64_t) 1 << 60;
+            uint64_t columnStride = (uint64_t) 1 << 63;
+            fs.seekp(24);
+            fs.write(reinterpret_cast<const char *>(&numSamples), sizeof(numSamples));
+            fs.seekp(40);
+            fs.write(reinterpret_cast<const char *>(&columnStride), sizeof(columnStride));
+        }
+
+        REQUIRE_THROWS(DataTable(fileName).getNumSamples());
+    }
+
+    remove(fileName);
+}
+
+TEST_CASE("DataTable files of older format versions can be loaded", COMMON_TAGS)
+{
+    const char *fileName = "test.datatable";
+
+    DataTable table(true);
+    table.addSample(std::vector<double>{2, 1}, 4);
+    table.addSample(std::vector<double>{1, 3}, 2);
+    table.addSample(std::vector<double>{1, 3}, 3);
+
+    // Version 1 has no tag, and stores the samples as a multiset of DataPoints followed by the grid
+    {
+        std::multiset<DataPoint> samples = table.getSamples();
+        std::vector<std::set<double>> grid{{1, 2}, {1, 3}};
+
+        Serializer s;
+        s.serialize(true);
+        s.serialize(false);
+        s.serialize((unsigned int) 1);
+        s.serialize((unsigned int) 2);
+        s.serialize(samples);
+        s.serialize(grid);
+        s.saveToFile(fileName);
+    }
+
+    DataTable loadedTable(fileName);
+    REQUIRE(loadedTable == table);
+    REQUIRE(loadedTable.getVectorY() == std::vector<double>({2, 3, 4}));
+
+    // Newer versions are rejected (the version follows the 4 byte magic number)
+    table.save(fileName);
+    {
+        std::fstream fs(fileName, std::fstream::in | std::fstream::out | std::fstream::binary);
+        fs.seekp(sizeof(uint32_t));
+        uint32_t version = 99;
+        fs.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    }
+    REQUIRE_THROWS(DataTable(fileName).getNumSamples());
+
+    remove(fileName);
+}
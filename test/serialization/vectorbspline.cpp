@@ -0,0 +1,86 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <Catch.h>
+#include <datatable.h>
+#include <bsplinebuilder.h>
+#include <vectorbspline.h>
+#include <utilities.h>
+#include "testingutilities.h"
+
+using namespace SPLINTER;
+
+
+#define COMMON_TAGS "[serialization][vectorbspline]"
+
+
+TEST_CASE("VectorBSpline can be saved and loaded", COMMON_TAGS)
+{
+    unsigned int dim = 2;
+    auto func = getTestFunction(dim, 1);
+    // Don't sample too fine, this test isn't supposed to test the speed
+    auto points = linspace(dim, std::pow(300, 1.0/dim));
+    DataTable table = sample(func, points);
+
+    DenseMatrix Y(table.getNumSamples(), 2);
+    int i = 0;
+    for (auto it = table.cbegin(); it != table.cend(); ++it, ++i)
+    {
+        Y(i, 0) = it->getY();
+        Y(i, 1) = 2*it->getY() + 1;
+    }
+
+    const char *fileName = "test.vectorbspline";
+
+    SECTION("Linear VectorBSpline")
+    {
+        VectorBSpline vectorBSpline(BSpline::Builder(table).degree(1).build(Y));
+        vectorBSpline.save(fileName);
+        VectorBSpline loadedVectorBSpline(fileName);
+        REQUIRE(vectorBSpline == loadedVectorBSpline);
+    }
+
+    SECTION("Cubic VectorBSpline")
+    {
+        VectorBSpline vectorBSpline(BSpline::Builder(table).degree(3).build(Y));
+        vectorBSpline.save(fileName);
+        VectorBSpline loadedVectorBSpline(fileName);
+        REQUIRE(vectorBSpline == loadedVectorBSpline);
+    }
+
+    remove(fileName);
+}
+
+TEST_CASE("VectorBSpline and BSpline files are not mixed up", COMMON_TAGS)
+{
+    unsigned int dim = 2;
+    auto func = getTestFunction(dim, 1);
+    auto points = linspace(dim, std::pow(100, 1.0/dim));
+    DataTable table = sample(func, points);
+
+    DenseMatrix Y(table.getNumSamples(), 2);
+    Y.col(0) = vectorToDenseVector(table.getVectorY());
+    Y.col(1) = 2*Y.col(0);
+
+    const char *fileName = "test.vectorbspline";
+
+    VectorBSpline vectorBSpline(BSpline::Builder(table).degree(3).build(Y));
+    vectorBSpline.save(fileName);
+    REQUIRE_THROWS(BSpline(fileName).getNumVariables());
+
+    BSpline bspline = BSpline::Builder(table).degree(3).build();
+    bspline.save(fileName);
+    REQUIRE_THROWS(VectorBSpline(fileName).getNumVariables());
+
+    table.save(fileName);
+    REQUIRE_THROWS(VectorBSpline(fileName).getNumVariables());
+    REQUIRE_THROWS(BSpline(fileName).getNumVariables());
+
+    remove(fileName);
+}
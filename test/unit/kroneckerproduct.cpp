@@ -0,0 +1,74 @@
+/*
+ * This file is part of the SPLINTER library.
+ * Copyright (C) 2012 Bjarne Grimstad (bjarne.grimstad@gmail.com).
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <Catch.h>
+#include <mykroneckerproduct.h>
+#include "unsupported/Eigen/KroneckerProduct"
+
+using namespace SPLINTER;
+
+#define COMMON_TAGS "[unit][kronecker]"
+#define COMMON_TEXT " unit test"
+
+
+// Sparse rows x cols matrix with a few nonzeros per column (and an empty column if cols > 2)
+static SparseMatrix sparseTestMatrix(int rows, int cols, int seed)
+{
+    SparseMatrix A(rows, cols);
+    for (int j = 0; j < cols; ++j)
+    {
+        if (j == 2)
+            continue;
+
+        for (int i = (j + seed) % 3; i < rows; i += 2 + (j % 2))
+            A.insert(i, j) = 1 + i - 0.5*j + 0.25*seed;
+    }
+    A.makeCompressed();
+    return A;
+}
+
+TEST_CASE("myKroneckerProduct" COMMON_TEXT, COMMON_TAGS)
+{
+    SparseMatrix A = sparseTestMatrix(5, 4, 0);
+    SparseMatrix B = sparseTestMatrix(3, 6, 1);
+
+    SparseMatrix AB = myKroneckerProduct(A, B);
+    SparseMatrix reference = Eigen::kroneckerProduct(A, B);
+
+    REQUIRE(AB.rows() == reference.rows());
+    REQUIRE(AB.cols() == reference.cols());
+    REQUIRE(AB.nonZeros() == reference.nonZeros());
+    REQUIRE(DenseMatrix(AB) == DenseMatrix(reference));
+}
+
+TEST_CASE("KroneckerOperator" COMMON_TEXT, COMMON_TAGS)
+{
+    SparseMatrix I(4, 4);
+    I.setIdentity();
+
+    std::vector<SparseMatrix> factors = {sparseTestMatrix(5, 3, 0), I, sparseTestMatrix(3, 6, 1)};
+    KroneckerOperator A(factors);
+
+    SparseMatrix reference = myKroneckerProduct(myKroneckerProduct(factors.at(0), factors.at(1)), factors.at(2));
+    REQUIRE(A.rows() == reference.rows());
+    REQUIRE(A.cols() == reference.cols());
+    REQUIRE(DenseMatrix(A.toSparse()) == DenseMatrix(reference));
+
+    DenseMatrix X(A.cols(), 3);
+    for (int i = 0; i < X.rows(); ++i)
+        for (int j = 0; j < X.cols(); ++j)
+            X(i, j) = std::sin(i + 3.0*j);
+
+    REQUIRE((A*X).isApprox(reference*X));
+
+    DenseMatrix Y = DenseMatrix::Ones(A.rows(), 2);
+    REQUIRE((A.transpose()*Y).isApprox(SparseMatrix(reference.transpose())*Y));
+
+    REQUIRE_THROWS(A*Y);
+}